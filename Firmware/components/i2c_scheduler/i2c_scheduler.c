@@ -0,0 +1,265 @@
+#include "i2c_scheduler.h"
+#include "driver/i2c_master.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "I2C_SCHED";
+
+// ------------------------- Globals -------------------------
+struct i2c_sched_device
+{
+    i2c_master_dev_handle_t handle;
+    uint32_t scl_hz;
+    i2c_sched_prio_t prio;
+    const char *name;
+    i2c_sched_dev_stats_t stats; // written by the scheduler task only
+};
+
+typedef struct
+{
+    i2c_sched_dev_t dev;
+    int64_t submit_us;
+    i2c_sched_txn_t txn;
+} sched_item_t;
+
+static i2c_master_bus_handle_t bus_handle;
+static struct i2c_sched_device devices[I2C_SCHED_MAX_DEVICES];
+static int num_devices;
+
+static QueueHandle_t prio_queue[I2C_SCHED_PRIO_COUNT];
+static SemaphoreHandle_t pending; // one count per queued transaction
+static TaskHandle_t sched_task_handle;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// ------------------------- Scheduler -------------------------
+static int hist_bucket(uint32_t us)
+{
+    if (us < 2)
+        return 0;
+    int b = 31 - __builtin_clz(us);
+    return b < I2C_SCHED_HIST_BUCKETS ? b : I2C_SCHED_HIST_BUCKETS - 1;
+}
+
+// The configured timeout is slack on top of the nominal transfer time, so a
+// long FIFO burst is not cut off just for being long: an address byte per
+// phase and 9 clocks per byte
+static int txn_timeout_ms(const struct i2c_sched_device *dev, const i2c_sched_txn_t *txn)
+{
+    uint32_t bytes = (txn->tx_len ? 1 + txn->tx_len : 0) + (txn->rx_len ? 1 + txn->rx_len : 0);
+    uint32_t xfer_ms = (uint32_t)(((uint64_t)bytes * 9 * 1000 + dev->scl_hz - 1) / dev->scl_hz);
+    return CONFIG_I2C_SCHED_XFER_TIMEOUT_MS + xfer_ms;
+}
+
+static esp_err_t run_txn(const struct i2c_sched_device *dev, const i2c_sched_txn_t *txn)
+{
+    const int timeout = txn_timeout_ms(dev, txn);
+    if (txn->tx_len && txn->rx_len)
+        return i2c_master_transmit_receive(dev->handle, txn->tx, txn->tx_len, txn->rx, txn->rx_len, timeout);
+    if (txn->tx_len)
+        return i2c_master_transmit(dev->handle, txn->tx, txn->tx_len, timeout);
+    return i2c_master_receive(dev->handle, txn->rx, txn->rx_len, timeout);
+}
+
+static void sched_task(void *arg)
+{
+    sched_item_t item;
+    for (;;)
+    {
+        if (xSemaphoreTake(pending, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        // Highest non-empty priority first; FIFO within one priority
+        int p;
+        for (p = 0; p < I2C_SCHED_PRIO_COUNT; p++)
+        {
+            if (xQueueReceive(prio_queue[p], &item, 0) == pdTRUE)
+                break;
+        }
+        if (p == I2C_SCHED_PRIO_COUNT)
+            continue;
+
+        int64_t start_us = esp_timer_get_time();
+        esp_err_t ret = run_txn(item.dev, &item.txn);
+        int64_t end_us = esp_timer_get_time();
+
+        uint32_t wait_us = (uint32_t)(start_us - item.submit_us);
+        uint32_t bus_us = (uint32_t)(end_us - start_us);
+        i2c_sched_dev_stats_t *s = &item.dev->stats;
+        taskENTER_CRITICAL(&stats_lock);
+        s->transactions++;
+        if (ret != ESP_OK)
+            s->errors++;
+        if (wait_us > s->wait_max_us)
+            s->wait_max_us = wait_us;
+        if (bus_us > s->bus_max_us)
+            s->bus_max_us = bus_us;
+        s->latency_hist[hist_bucket(wait_us + bus_us)]++;
+        taskEXIT_CRITICAL(&stats_lock);
+
+        if (ret != ESP_OK)
+            ESP_LOGD(TAG, "%s: transaction failed (%s)", item.dev->name, esp_err_to_name(ret));
+        if (item.txn.done)
+            item.txn.done(ret, item.txn.arg);
+    }
+}
+
+// ------------------------- Public API -------------------------
+esp_err_t i2c_scheduler_submit(i2c_sched_dev_t dev, const i2c_sched_txn_t *txn, uint32_t wait_ms)
+{
+    if (!dev || !txn || txn->tx_len > I2C_SCHED_TX_MAX || (txn->rx_len && !txn->rx) ||
+        (!txn->tx_len && !txn->rx_len))
+        return ESP_ERR_INVALID_ARG;
+
+    sched_item_t item = {
+        .dev = dev,
+        .submit_us = esp_timer_get_time(),
+        .txn = *txn};
+    if (xQueueSend(prio_queue[dev->prio], &item, pdMS_TO_TICKS(wait_ms)) != pdTRUE)
+    {
+        taskENTER_CRITICAL(&stats_lock);
+        dev->stats.queue_full++;
+        taskEXIT_CRITICAL(&stats_lock);
+        return ESP_ERR_TIMEOUT;
+    }
+    xSemaphoreGive(pending);
+    return ESP_OK;
+}
+
+typedef struct
+{
+    SemaphoreHandle_t done;
+    esp_err_t result;
+} sync_wait_t;
+
+static void sync_done(esp_err_t result, void *arg)
+{
+    sync_wait_t *w = arg;
+    w->result = result;
+    xSemaphoreGive(w->done);
+}
+
+esp_err_t i2c_scheduler_transfer(i2c_sched_dev_t dev, const uint8_t *tx, size_t tx_len,
+                                 uint8_t *rx, size_t rx_len)
+{
+    // A callback waiting on its own queue would never return
+    if (xTaskGetCurrentTaskHandle() == sched_task_handle)
+        return ESP_ERR_INVALID_STATE;
+    if (tx_len > I2C_SCHED_TX_MAX)
+        return ESP_ERR_INVALID_ARG;
+
+    StaticSemaphore_t sem_buf;
+    sync_wait_t w = {
+        .done = xSemaphoreCreateBinaryStatic(&sem_buf),
+        .result = ESP_FAIL};
+    i2c_sched_txn_t txn = {
+        .tx_len = tx_len,
+        .rx = rx,
+        .rx_len = rx_len,
+        .done = sync_done,
+        .arg = &w};
+    if (tx_len)
+        memcpy(txn.tx, tx, tx_len);
+
+    esp_err_t ret = i2c_scheduler_submit(dev, &txn, CONFIG_I2C_SCHED_XFER_TIMEOUT_MS);
+    if (ret == ESP_OK)
+    {
+        // Unbounded on purpose: w and rx live on this stack frame until the
+        // callback has run, and the driver timeout already bounds the transfer
+        xSemaphoreTake(w.done, portMAX_DELAY);
+        ret = w.result;
+    }
+    vSemaphoreDelete(w.done);
+    return ret;
+}
+
+esp_err_t i2c_scheduler_get_stats(i2c_sched_dev_t dev, i2c_sched_dev_stats_t *out)
+{
+    if (!dev || !out)
+        return ESP_ERR_INVALID_ARG;
+    taskENTER_CRITICAL(&stats_lock);
+    *out = dev->stats;
+    taskEXIT_CRITICAL(&stats_lock);
+    return ESP_OK;
+}
+
+void i2c_scheduler_log_stats(void)
+{
+    for (int i = 0; i < num_devices; i++)
+    {
+        i2c_sched_dev_stats_t s;
+        i2c_scheduler_get_stats(&devices[i], &s);
+
+        char line[I2C_SCHED_HIST_BUCKETS * 11 + 1];
+        int len = 0;
+        for (int b = 0; b < I2C_SCHED_HIST_BUCKETS && len < (int)sizeof(line); b++)
+            len += snprintf(line + len, sizeof(line) - len, " %lu", (unsigned long)s.latency_hist[b]);
+
+        ESP_LOGI(TAG, "%s: n=%lu err=%lu full=%lu wait_max=%luus bus_max=%luus hist(log2 us):%s",
+                 devices[i].name, (unsigned long)s.transactions, (unsigned long)s.errors,
+                 (unsigned long)s.queue_full, (unsigned long)s.wait_max_us,
+                 (unsigned long)s.bus_max_us, line);
+    }
+}
+
+esp_err_t i2c_scheduler_add_device(uint16_t addr, uint32_t scl_hz, i2c_sched_prio_t prio,
+                                   const char *name, i2c_sched_dev_t *out)
+{
+    if (!bus_handle || prio >= I2C_SCHED_PRIO_COUNT || !scl_hz || !out)
+        return ESP_ERR_INVALID_STATE;
+    if (num_devices >= I2C_SCHED_MAX_DEVICES)
+        return ESP_ERR_NO_MEM;
+
+    i2c_device_config_t dev_cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = addr,
+        .scl_speed_hz = scl_hz};
+    struct i2c_sched_device *dev = &devices[num_devices];
+    esp_err_t ret = i2c_master_bus_add_device(bus_handle, &dev_cfg, &dev->handle);
+    if (ret != ESP_OK)
+        return ret;
+
+    dev->scl_hz = scl_hz;
+    dev->prio = prio;
+    dev->name = name;
+    memset(&dev->stats, 0, sizeof(dev->stats));
+    num_devices++;
+    *out = dev;
+    return ESP_OK;
+}
+
+esp_err_t i2c_scheduler_init(const i2c_sched_bus_config_t *cfg)
+{
+    i2c_master_bus_config_t bus_cfg = {
+        .i2c_port = cfg->port,
+        .sda_io_num = cfg->sda_io,
+        .scl_io_num = cfg->scl_io,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = false};
+    esp_err_t ret = i2c_new_master_bus(&bus_cfg, &bus_handle);
+    if (ret != ESP_OK)
+        return ret;
+
+    for (int p = 0; p < I2C_SCHED_PRIO_COUNT; p++)
+    {
+        prio_queue[p] = xQueueCreate(CONFIG_I2C_SCHED_QUEUE_LEN, sizeof(sched_item_t));
+        if (!prio_queue[p])
+            return ESP_ERR_NO_MEM;
+    }
+    pending = xSemaphoreCreateCounting(I2C_SCHED_PRIO_COUNT * CONFIG_I2C_SCHED_QUEUE_LEN, 0);
+    if (!pending)
+        return ESP_ERR_NO_MEM;
+
+    if (xTaskCreatePinnedToCore(sched_task, "i2c_sched", 3072, NULL, CONFIG_I2C_SCHED_TASK_PRIORITY,
+                                &sched_task_handle, 1) != pdPASS)
+        return ESP_ERR_NO_MEM;
+
+    ESP_LOGI(TAG, "Bus %d ready (SDA %d, SCL %d)", cfg->port, cfg->sda_io, cfg->scl_io);
+    return ESP_OK;
+}
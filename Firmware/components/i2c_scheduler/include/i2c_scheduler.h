@@ -0,0 +1,109 @@
+#ifndef I2C_SCHEDULER_H
+#define I2C_SCHEDULER_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ------------------------- Config -------------------------
+#define I2C_SCHED_MAX_DEVICES 8
+#define I2C_SCHED_TX_MAX 8         // write bytes are copied into the transaction
+#define I2C_SCHED_HIST_BUCKETS 16  // bucket i counts latencies in [2^i, 2^(i+1)) us
+
+// ------------------------- Data Structures -------------------------
+
+// Lower value is served first. A transaction already on the bus is never
+// preempted; priority decides which queued transaction goes next.
+typedef enum
+{
+    I2C_SCHED_PRIO_HIGH = 0, // FIFO drain, must keep up with the sensor rate
+    I2C_SCHED_PRIO_NORMAL,
+    I2C_SCHED_PRIO_LOW,
+    I2C_SCHED_PRIO_COUNT
+} i2c_sched_prio_t;
+
+typedef struct i2c_sched_device *i2c_sched_dev_t;
+
+/**
+ * @brief Completion callback, runs in the scheduler task.
+ * Must not block; hand the result off to the owner and return.
+ * @param result ESP_OK or the driver error
+ * @param arg User argument from the transaction
+ */
+typedef void (*i2c_sched_done_cb_t)(esp_err_t result, void *arg);
+
+// One bus transaction: write tx_len bytes, then read rx_len bytes with a
+// repeated start. Either part may be empty.
+typedef struct
+{
+    uint8_t tx[I2C_SCHED_TX_MAX];
+    uint8_t tx_len;
+    uint8_t *rx; // must stay valid until the callback runs
+    size_t rx_len;
+    i2c_sched_done_cb_t done;
+    void *arg;
+} i2c_sched_txn_t;
+
+typedef struct
+{
+    uint32_t transactions;
+    uint32_t errors;
+    uint32_t queue_full;                            // submissions rejected
+    uint32_t wait_max_us;                           // queued until started
+    uint32_t bus_max_us;                            // started until finished
+    uint32_t latency_hist[I2C_SCHED_HIST_BUCKETS];  // submitted until finished
+} i2c_sched_dev_stats_t;
+
+typedef struct
+{
+    int port;
+    int sda_io;
+    int scl_io;
+} i2c_sched_bus_config_t;
+
+// ------------------------- API -------------------------
+
+/**
+ * @brief Create the I2C master bus and start the scheduler task.
+ * From here on the scheduler is the only owner of the bus.
+ */
+esp_err_t i2c_scheduler_init(const i2c_sched_bus_config_t *cfg);
+
+/**
+ * @brief Attach a 7-bit device to the bus.
+ * @param addr Device address
+ * @param scl_hz Clock speed for this device
+ * @param prio Queue all transactions of this device at this priority
+ * @param name Short name for logs, must outlive the device
+ * @param out Device handle
+ */
+esp_err_t i2c_scheduler_add_device(uint16_t addr, uint32_t scl_hz, i2c_sched_prio_t prio,
+                                   const char *name, i2c_sched_dev_t *out);
+
+/**
+ * @brief Queue a transaction without waiting for it.
+ * The transaction is copied; only the rx buffer must stay valid until done.
+ * @return ESP_ERR_TIMEOUT if the device's priority queue stayed full
+ */
+esp_err_t i2c_scheduler_submit(i2c_sched_dev_t dev, const i2c_sched_txn_t *txn, uint32_t wait_ms);
+
+/**
+ * @brief Queue a transaction and block until it has finished.
+ * @param tx Bytes to write, at most I2C_SCHED_TX_MAX
+ * @param rx Buffer to read into, NULL if rx_len is 0
+ */
+esp_err_t i2c_scheduler_transfer(i2c_sched_dev_t dev, const uint8_t *tx, size_t tx_len,
+                                 uint8_t *rx, size_t rx_len);
+
+/**
+ * @brief Copy the latency statistics of one device.
+ */
+esp_err_t i2c_scheduler_get_stats(i2c_sched_dev_t dev, i2c_sched_dev_stats_t *out);
+
+/**
+ * @brief Log the latency histogram of every device.
+ */
+void i2c_scheduler_log_stats(void);
+
+#endif // I2C_SCHEDULER_H
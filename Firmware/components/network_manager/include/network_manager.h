@@ -4,6 +4,7 @@
 #define NETWORK_MANAGER_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 // Enum to represent the network status for your LCD
 typedef enum {
@@ -20,6 +21,10 @@ typedef enum {
 // Define the callback function pointer type
 typedef void (*network_status_callback_t)(network_status_t status);
 
+// Incoming message on a subscribed topic; runs in the MQTT client task.
+// data is not NUL-terminated.
+typedef void (*network_message_callback_t)(const char *data, size_t len);
+
 /**
  * @brief Starts the network manager.
  * * It will first attempt to connect to the configured Wi-Fi and MQTT broker.
@@ -36,4 +41,25 @@ void network_manager_start(network_status_callback_t status_callback);
  */
 bool network_manager_publish(const char *topic, const char *payload);
 
+/**
+ * @brief Publish a binary payload of the given length (QoS 0).
+ * * Large payloads do not fit the text publish queue, so this writes the
+ * message from the calling task instead of queueing a copy.
+ * @param topic The MQTT topic to publish to.
+ * @param payload The message payload, may contain zero bytes.
+ * @param len Payload length in bytes.
+ * @return true if the message was handed to the MQTT client, false otherwise.
+ */
+bool network_manager_publish_binary(const char *topic, const void *payload, size_t len);
+
+/**
+ * @brief Subscribe to a topic (QoS 1). The subscription is renewed on every
+ * (re)connect, so this may be called before the network is up.
+ * * Messages split over several MQTT data events are dropped.
+ * @param topic The MQTT topic, no wildcards; must outlive the subscription.
+ * @param callback Called for every message received on the topic.
+ * @return true if the subscription was registered, false if the table is full.
+ */
+bool network_manager_subscribe(const char *topic, network_message_callback_t callback);
+
 #endif // NETWORK_MANAGER_H
\ No newline at end of file
@@ -49,6 +49,17 @@ typedef struct
 
 static QueueHandle_t s_publish_queue = NULL;
 
+// --- Subscriptions ---
+#define MQTT_MAX_SUBSCRIPTIONS 4
+typedef struct
+{
+    const char *topic;
+    network_message_callback_t callback;
+} mqtt_subscription_t;
+
+static mqtt_subscription_t s_subscriptions[MQTT_MAX_SUBSCRIPTIONS];
+static volatile int s_num_subscriptions = 0;
+
 // Function to safely call the status callback
 static void update_status(network_status_t status)
 {
@@ -86,6 +97,10 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         update_status(NETWORK_STATUS_CONNECTED_INTERNET);
 
         esp_mqtt_client_subscribe(event->client, CONFIG_MQTT_TOPIC, 0);
+        for (int i = 0; i < s_num_subscriptions; i++)
+        {
+            esp_mqtt_client_subscribe(event->client, s_subscriptions[i].topic, 1);
+        }
         break;
 
     case MQTT_EVENT_DISCONNECTED:
@@ -93,6 +108,22 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
         break;
 
+    case MQTT_EVENT_DATA:
+        if (event->current_data_offset != 0 || event->data_len != event->total_data_len)
+        {
+            ESP_LOGW(TAG, "Fragmented message (%d bytes) dropped", event->total_data_len);
+            break;
+        }
+        for (int i = 0; i < s_num_subscriptions; i++)
+        {
+            const char *topic = s_subscriptions[i].topic;
+            if ((size_t)event->topic_len == strlen(topic) && strncmp(event->topic, topic, event->topic_len) == 0)
+            {
+                s_subscriptions[i].callback(event->data, event->data_len);
+            }
+        }
+        break;
+
     case MQTT_EVENT_PUBLISHED:
         // ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
         break;
@@ -189,6 +220,43 @@ bool network_manager_publish(const char *topic, const char *payload)
     return true;
 }
 
+bool network_manager_publish_binary(const char *topic, const void *payload, size_t len)
+{
+    if (!s_mqtt_connected || s_active_client == NULL)
+    {
+        ESP_LOGW(TAG, "MQTT not connected, dropping message on %s", topic);
+        return false;
+    }
+
+    int msg_id = esp_mqtt_client_publish(s_active_client, topic, payload, (int)len, 0, 0);
+    if (msg_id == -1)
+    {
+        ESP_LOGW(TAG, "Failed to publish to topic %s", topic);
+        return false;
+    }
+    return true;
+}
+
+bool network_manager_subscribe(const char *topic, network_message_callback_t callback)
+{
+    if (s_num_subscriptions >= MQTT_MAX_SUBSCRIPTIONS)
+    {
+        ESP_LOGE(TAG, "No free subscription slot for %s", topic);
+        return false;
+    }
+
+    // Fill the slot before publishing the count to the MQTT task
+    s_subscriptions[s_num_subscriptions].topic = topic;
+    s_subscriptions[s_num_subscriptions].callback = callback;
+    s_num_subscriptions++;
+
+    if (s_mqtt_connected && s_active_client != NULL)
+    {
+        esp_mqtt_client_subscribe(s_active_client, topic, 1);
+    }
+    return true;
+}
+
 // --- Wi-Fi Handlers ---
 static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
 {
@@ -0,0 +1,119 @@
+#include "attitude.h"
+#include <math.h>
+#include <string.h>
+
+#define RAD_TO_DEG (180.0f / (float)M_PI)
+#define ATTITUDE_SETTLE_TAUS 4 // reference is taken once the filter has settled
+
+// Angle between two vectors in degrees
+static float vec_angle_deg(const int32_t a[3], const int32_t b[3])
+{
+    float dot = 0.0f, na = 0.0f, nb = 0.0f;
+    for (int i = 0; i < 3; i++)
+    {
+        dot += (float)a[i] * (float)b[i];
+        na += (float)a[i] * (float)a[i];
+        nb += (float)b[i] * (float)b[i];
+    }
+    if (na == 0.0f || nb == 0.0f)
+        return 0.0f;
+    float c = dot / sqrtf(na * nb);
+    if (c > 1.0f)
+        c = 1.0f;
+    else if (c < -1.0f)
+        c = -1.0f;
+    return acosf(c) * RAD_TO_DEG;
+}
+
+void attitude_init(attitude_t *a, int sample_rate_hz)
+{
+    memset(a, 0, sizeof(*a));
+    a->block_samples = sample_rate_hz * ATTITUDE_BLOCK_MS / 1000;
+
+    // Filter time constant tau = 2^alpha_shift samples
+    int tau_samples = CONFIG_SENSOR_ATTITUDE_TAU_MS * sample_rate_hz / 1000;
+    a->alpha_shift = 1;
+    while (a->alpha_shift < 16 && (1 << (a->alpha_shift + 1)) <= tau_samples)
+        a->alpha_shift++;
+
+    double rad_per_lsb_sample = (M_PI / 180.0) / (MPU_GYRO_LSB_PER_DPS * sample_rate_hz);
+    a->gyro_k_q32 = (int64_t)llround(rad_per_lsb_sample * 4294967296.0);
+
+    a->settle_blocks = (ATTITUDE_SETTLE_TAUS * CONFIG_SENSOR_ATTITUDE_TAU_MS + ATTITUDE_BLOCK_MS - 1) / ATTITUDE_BLOCK_MS;
+}
+
+void attitude_set_reference(attitude_t *a)
+{
+    memcpy(a->ref, a->g, sizeof(a->ref));
+    a->ref_valid = a->initialized;
+}
+
+bool attitude_update(attitude_t *a, const int16_t accel[3], const int16_t *gyro, sensor_attitude_t *out)
+{
+    int32_t *g = a->g;
+    if (!a->initialized)
+    {
+        for (int i = 0; i < 3; i++)
+            g[i] = accel[i] * (1 << ATTITUDE_FRAC_BITS); // negative counts: multiply, not shift
+        memcpy(a->prev, g, sizeof(a->prev));
+        a->initialized = true;
+    }
+
+    // Gyro propagation: a fixed vector seen from a rotating body turns by
+    // g x w per unit time
+    if (gyro)
+    {
+        int64_t cx = (int64_t)g[1] * gyro[2] - (int64_t)g[2] * gyro[1];
+        int64_t cy = (int64_t)g[2] * gyro[0] - (int64_t)g[0] * gyro[2];
+        int64_t cz = (int64_t)g[0] * gyro[1] - (int64_t)g[1] * gyro[0];
+        const int64_t half = 1LL << 31; // round to nearest, no drift from truncation
+        g[0] += (int32_t)((cx * a->gyro_k_q32 + half) >> 32);
+        g[1] += (int32_t)((cy * a->gyro_k_q32 + half) >> 32);
+        g[2] += (int32_t)((cz * a->gyro_k_q32 + half) >> 32);
+    }
+
+    // Accel correction
+    for (int i = 0; i < 3; i++)
+        g[i] += ((accel[i] * (1 << ATTITUDE_FRAC_BITS)) - g[i]) >> a->alpha_shift;
+
+    if (++a->block_fill < a->block_samples)
+        return false;
+    a->block_fill = 0;
+
+    // Block end: orientation, tilt and movement
+    float gx = (float)g[0], gy = (float)g[1], gz = (float)g[2];
+    float scale = 1.0f / ((1 << ATTITUDE_FRAC_BITS) * MPU_ACCEL_LSB_PER_G);
+    memset(out, 0, sizeof(*out));
+    out->motion.accel_x_g = gx * scale;
+    out->motion.accel_y_g = gy * scale;
+    out->motion.accel_z_g = gz * scale;
+    if (gyro)
+    {
+        out->motion.gyro_x_dps = gyro[0] / MPU_GYRO_LSB_PER_DPS;
+        out->motion.gyro_y_dps = gyro[1] / MPU_GYRO_LSB_PER_DPS;
+        out->motion.gyro_z_dps = gyro[2] / MPU_GYRO_LSB_PER_DPS;
+    }
+    out->motion.roll = atan2f(gy, gz) * RAD_TO_DEG;
+    out->motion.pitch = atan2f(-gx, sqrtf(gy * gy + gz * gz)) * RAD_TO_DEG;
+
+    float rate_dps = vec_angle_deg(g, a->prev) * (1000.0f / ATTITUDE_BLOCK_MS);
+    memcpy(a->prev, g, sizeof(a->prev));
+    bool moving = rate_dps > CONFIG_SENSOR_MOVE_DEG_PER_S;
+    if (moving && !a->moving)
+        a->move_events++;
+    a->moving = moving;
+
+    if (a->settle_blocks)
+        a->settle_blocks--;
+    else if (!a->ref_valid && !moving)
+        attitude_set_reference(a);
+
+    if (a->ref_valid)
+    {
+        out->tilt_deg = vec_angle_deg(g, a->ref);
+        out->tilted = out->tilt_deg > CONFIG_SENSOR_TILT_ALARM_DEG;
+    }
+    out->moving = moving;
+    out->move_events = a->move_events;
+    return true;
+}
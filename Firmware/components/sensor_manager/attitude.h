@@ -0,0 +1,54 @@
+#ifndef ATTITUDE_H
+#define ATTITUDE_H
+
+#include "sensor_manager.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Complementary-filter attitude estimator in integer arithmetic. The state is
+// the gravity vector in the sensor frame (accel LSB, Q14). Every sample
+// rotates it by the gyro rate, if the FIFO carries gyro data, and pulls it
+// towards the measured acceleration by 2^-alpha_shift; vibration averages
+// out while real rotations are followed. Pitch, roll, tilt and the
+// movement check are derived in float once per block (100 ms), never per
+// sample.
+
+#define ATTITUDE_BLOCK_MS 100
+#define ATTITUDE_FRAC_BITS 14 // full scale << 14 still leaves 2 bits of headroom
+
+typedef struct
+{
+    int32_t g[3];    // gravity estimate, accel LSB << ATTITUDE_FRAC_BITS
+    int32_t prev[3]; // estimate at the end of the previous block
+    int32_t ref[3];  // reference orientation, valid if ref_valid
+    int64_t gyro_k_q32; // rad per gyro LSB per sample, Q32
+    int alpha_shift;
+    int block_samples;
+    int block_fill;
+    uint32_t settle_blocks; // blocks left before the reference may be taken
+    bool initialized;
+    bool ref_valid;
+    bool moving;
+    uint32_t move_events;
+} attitude_t;
+
+/**
+ * @brief Reset the estimator for the given sample rate.
+ */
+void attitude_init(attitude_t *a, int sample_rate_hz);
+
+/**
+ * @brief Take the current orientation as the upright reference for the
+ * tilt check. Only call from the task that runs attitude_update().
+ */
+void attitude_set_reference(attitude_t *a);
+
+/**
+ * @brief Add one sample (raw counts, offsets already applied).
+ * @param gyro Raw gyro counts, NULL if the FIFO carries none
+ * @param out Written when a block closes (pitch, roll, tilt, movement)
+ * @return true if out was written
+ */
+bool attitude_update(attitude_t *a, const int16_t accel[3], const int16_t *gyro, sensor_attitude_t *out);
+
+#endif // ATTITUDE_H
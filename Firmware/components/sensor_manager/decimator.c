@@ -0,0 +1,134 @@
+#include "decimator.h"
+#include <math.h>
+#include <string.h>
+
+#if CONFIG_IDF_TARGET_LINUX
+// No esp-dsp on the linux target; same arithmetic as dsps_dotprod_f32_ansi
+static inline void dsps_dotprod_f32(const float *src1, const float *src2, float *dest, int len)
+{
+    float acc = 0.0f;
+    for (int i = 0; i < len; i++)
+        acc += src1[i] * src2[i];
+    *dest = acc;
+}
+#else
+#include "dsps_dotprod.h"
+#endif
+
+// Split factor into at most max_stages factors <= DECIM_MAX_FACTOR,
+// largest first so the high-rate stage does most of the reduction
+static int decimator_split(int factor, int *factors, int max_stages)
+{
+    if (factor <= DECIM_MAX_FACTOR)
+    {
+        factors[0] = factor;
+        return 1;
+    }
+    if (max_stages < 2)
+        return 0;
+    for (int f = DECIM_MAX_FACTOR; f >= 2; f--)
+    {
+        if (factor % f != 0)
+            continue;
+        int n = decimator_split(factor / f, factors + 1, max_stages - 1);
+        if (n > 0)
+        {
+            factors[0] = f;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+// Blackman-windowed sinc low-pass, -6 dB at 80% of the output Nyquist
+static void decim_stage_init(decim_stage_t *st, int factor)
+{
+    int n = DECIM_TAPS_PER_FACTOR * factor + 1;
+    float fc = 0.4f / factor; // cycles per input sample
+    int taps = (n + DECIM_ALIGN - 1) & ~(DECIM_ALIGN - 1); // padded for the SIMD kernel
+    int pad = taps - n; // zeros go on the oldest end, so the delay stays (n - 1) / 2
+    float h[DECIM_MAX_TAPS] = {0};
+    float sum = 0.0f;
+
+    memset(st, 0, sizeof(*st));
+    for (int i = 0; i < n; i++)
+    {
+        float m = i - (n - 1) / 2.0f;
+        float sinc = (m == 0.0f) ? 2.0f * fc : sinf(2.0f * (float)M_PI * fc * m) / ((float)M_PI * m);
+        float w = 0.42f - 0.5f * cosf(2.0f * (float)M_PI * i / (n - 1)) + 0.08f * cosf(4.0f * (float)M_PI * i / (n - 1));
+        h[pad + i] = sinc * w;
+        sum += sinc * w;
+    }
+    for (int s = 0; s < DECIM_ALIGN; s++)
+        for (int i = 0; i < taps; i++)
+            st->coeffs[s][s + i] = h[i] / sum; // unity DC gain
+
+    st->taps = taps;
+    st->factor = factor;
+}
+
+bool decimator_rate_supported(int input_rate_hz, int output_rate_hz)
+{
+    int factors[DECIM_MAX_STAGES];
+    return output_rate_hz > 0 && input_rate_hz % output_rate_hz == 0 &&
+           decimator_split(input_rate_hz / output_rate_hz, factors, DECIM_MAX_STAGES) > 0;
+}
+
+esp_err_t decimator_init(decimator_t *d, int input_rate_hz, int output_rate_hz)
+{
+    int factors[DECIM_MAX_STAGES];
+    if (output_rate_hz <= 0 || input_rate_hz % output_rate_hz != 0)
+        return ESP_ERR_INVALID_ARG;
+    int stages = decimator_split(input_rate_hz / output_rate_hz, factors, DECIM_MAX_STAGES);
+    if (stages == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    d->num_stages = stages;
+    d->input_rate_hz = input_rate_hz;
+    d->output_rate_hz = output_rate_hz;
+    d->delay_samples = 0;
+
+    int scale = 1; // input samples per sample entering this stage
+    for (int s = 0; s < stages; s++)
+    {
+        decim_stage_init(&d->stages[s], factors[s]);
+        d->delay_samples += (DECIM_TAPS_PER_FACTOR * factors[s] / 2) * scale;
+        scale *= factors[s];
+    }
+    return ESP_OK;
+}
+
+static bool decim_stage_push(decim_stage_t *st, const float *in, float *out)
+{
+    int pos = st->pos;
+    for (int a = 0; a < DECIM_AXES; a++)
+        st->delay[a][pos] = st->delay[a][pos + st->taps] = in[a];
+    st->pos = (pos + 1 == st->taps) ? 0 : pos + 1;
+
+    if (++st->phase < st->factor)
+        return false;
+    st->phase = 0;
+
+    // delay[pos .. pos+taps-1] runs oldest to newest. Since taps is a
+    // multiple of DECIM_ALIGN, the aligned window of taps + DECIM_ALIGN
+    // samples below it still lies within the doubled line.
+    int start = st->pos & ~(DECIM_ALIGN - 1);
+    const float *coeffs = st->coeffs[st->pos - start];
+    for (int a = 0; a < DECIM_AXES; a++)
+        dsps_dotprod_f32(&st->delay[a][start], coeffs, &out[a], st->taps + DECIM_ALIGN);
+    return true;
+}
+
+bool decimator_push(decimator_t *d, const float in[DECIM_AXES], float out[DECIM_AXES])
+{
+    float buf[DECIM_AXES];
+    const float *src = in;
+    for (int s = 0; s < d->num_stages; s++)
+    {
+        if (!decim_stage_push(&d->stages[s], src, buf))
+            return false;
+        src = buf;
+    }
+    memcpy(out, buf, sizeof(buf));
+    return true;
+}
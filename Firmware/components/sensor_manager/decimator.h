@@ -0,0 +1,74 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Anti-aliased decimator for the accel (and, if captured, gyro) stream.
+// Cascaded linear-phase FIR stages (windowed sinc, Blackman); each stage
+// only computes the outputs it keeps, so the cost is taps * rate_out per
+// stage.
+
+#if CONFIG_MPU6050_FIFO_GYRO
+#define DECIM_AXES 6 // accel x/y/z, gyro x/y/z
+#else
+#define DECIM_AXES 3
+#endif
+#if CONFIG_SENSOR_HAL_SYNTH
+#define DECIM_MAX_STAGES 3 // synthetic input may run at up to 10 kHz
+#else
+#define DECIM_MAX_STAGES 2
+#endif
+#define DECIM_MAX_FACTOR 10
+#define DECIM_TAPS_PER_FACTOR 12
+#define DECIM_MAX_TAPS (((DECIM_TAPS_PER_FACTOR * DECIM_MAX_FACTOR + 1) + 3) & ~3)
+#define DECIM_ALIGN 4 // floats per 16-byte SIMD load
+
+typedef struct
+{
+    // The window can start anywhere in the delay line, but the SIMD dot
+    // product needs 16-byte aligned inputs. It starts at the aligned slot at
+    // or below the window instead, with the filter shifted by the distance:
+    // coeffs[s] holds it s taps in, zeros around it.
+    float coeffs[DECIM_ALIGN][DECIM_MAX_TAPS + DECIM_ALIGN] __attribute__((aligned(16)));
+    // Each delay line is stored twice so the newest `taps` samples are
+    // always contiguous for the dot product
+    float delay[DECIM_AXES][2 * DECIM_MAX_TAPS] __attribute__((aligned(16)));
+    int taps;
+    int factor;
+    int pos;
+    int phase;
+} decim_stage_t;
+
+typedef struct
+{
+    decim_stage_t stages[DECIM_MAX_STAGES];
+    int num_stages;
+    int input_rate_hz;
+    int output_rate_hz;
+    uint32_t delay_samples; // group delay in input samples
+} decimator_t;
+
+/**
+ * @brief Check whether input_rate_hz -> output_rate_hz can be realized.
+ */
+bool decimator_rate_supported(int input_rate_hz, int output_rate_hz);
+
+/**
+ * @brief Design the filter cascade for input_rate_hz -> output_rate_hz.
+ * @return ESP_ERR_INVALID_ARG if the ratio is not an integer that splits into
+ *         at most DECIM_MAX_STAGES factors of DECIM_MAX_FACTOR or less
+ */
+esp_err_t decimator_init(decimator_t *d, int input_rate_hz, int output_rate_hz);
+
+/**
+ * @brief Feed one input sample.
+ * @param in Input sample, one value per axis
+ * @param out Filtered output, written only when the function returns true
+ * @return true when an output sample is ready
+ */
+bool decimator_push(decimator_t *d, const float in[DECIM_AXES], float out[DECIM_AXES]);
+
+#endif // DECIMATOR_H
@@ -0,0 +1,53 @@
+#include "energy_meter.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include <string.h>
+
+static const char *TAG = "ENERGY_METER";
+
+#define ENERGY_NVS_NAMESPACE "sensor"
+#define ENERGY_NVS_KEY "energy_uj"
+#define PJ_PER_UJ 1000000ULL
+
+void energy_meter_init(energy_meter_t *m, uint32_t power_lsb_uw)
+{
+    memset(m, 0, sizeof(*m));
+    m->power_lsb_uw = power_lsb_uw;
+
+    nvs_handle_t nvs;
+    if (nvs_open(ENERGY_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+        return; // first boot: namespace does not exist yet
+    if (nvs_get_u64(nvs, ENERGY_NVS_KEY, &m->total_uj) == ESP_OK)
+    {
+        m->saved_uj = m->total_uj;
+        ESP_LOGI(TAG, "Restored energy total: %.3f Wh", energy_meter_wh(m));
+    }
+    nvs_close(nvs);
+}
+
+void energy_meter_add(energy_meter_t *m, uint16_t power_raw, uint32_t dt_us)
+{
+    // µW * µs = pJ; at most 65535 * 25 * LSB * dt, far from overflowing
+    uint64_t pj = (uint64_t)power_raw * m->power_lsb_uw * dt_us + m->residual_pj;
+    m->total_uj += pj / PJ_PER_UJ;
+    m->residual_pj = pj % PJ_PER_UJ;
+}
+
+esp_err_t energy_meter_save(energy_meter_t *m)
+{
+    if (m->total_uj == m->saved_uj)
+        return ESP_OK;
+
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(ENERGY_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret != ESP_OK)
+        return ret;
+    ret = nvs_set_u64(nvs, ENERGY_NVS_KEY, m->total_uj);
+    if (ret == ESP_OK)
+        ret = nvs_commit(nvs);
+    nvs_close(nvs);
+
+    if (ret == ESP_OK)
+        m->saved_uj = m->total_uj;
+    return ret;
+}
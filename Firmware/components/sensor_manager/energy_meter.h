@@ -0,0 +1,42 @@
+#ifndef ENERGY_METER_H
+#define ENERGY_METER_H
+
+#include "esp_err.h"
+#include <stdint.h>
+
+// Energy counter fed with raw INA226 power readings. Each reading is held for
+// the time until the next one; power_raw * LSB * dt is accumulated as an
+// integer in µJ and the sub-µJ remainder is carried to the next step, so the
+// total never drifts however long the device runs. The total is kept in NVS
+// and survives restarts.
+
+typedef struct
+{
+    uint64_t total_uj;
+    uint64_t residual_pj; // < 1 µJ, carried to the next step
+    uint32_t power_lsb_uw;
+    uint64_t saved_uj; // total at the last NVS write
+} energy_meter_t;
+
+/**
+ * @brief Reset the counter and restore the persisted total, if any.
+ * @param power_lsb_uw Power register LSB in µW (25 * current LSB)
+ */
+void energy_meter_init(energy_meter_t *m, uint32_t power_lsb_uw);
+
+/**
+ * @brief Integrate one power reading over dt_us.
+ */
+void energy_meter_add(energy_meter_t *m, uint16_t power_raw, uint32_t dt_us);
+
+/**
+ * @brief Persist the total to NVS if it changed since the last save.
+ */
+esp_err_t energy_meter_save(energy_meter_t *m);
+
+static inline double energy_meter_wh(const energy_meter_t *m)
+{
+    return m->total_uj / 3.6e9;
+}
+
+#endif // ENERGY_METER_H
@@ -7,11 +7,27 @@
 #include "freertos/semphr.h"
 #include "freertos/queue.h"
 #include "esp_err.h"
+#include "sdkconfig.h"
+#include <math.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 // ------------------------- Config -------------------------
 #define BATCH_SIZE 1000
+#define MPU_ACCEL_LSB_PER_G 16384.0f // +-2 g full scale
+#define MPU_GYRO_LSB_PER_DPS 131.0f  // +-250 dps full scale
+#define SENSOR_SPECTRUM_MAX_PEAKS 10 // one spectrum must fit a 256-byte MQTT payload
+#if CONFIG_SENSOR_HAL_SYNTH
+#define SENSOR_SAMPLE_RATE_HZ CONFIG_SENSOR_SYNTH_RATE_HZ // generator rate instead of the MPU's 1 kHz
+#else
+#define SENSOR_SAMPLE_RATE_HZ 1000
+#endif
+#if CONFIG_ENABLE_INA226
+// A new INA226 result is ready every averages x (bus + shunt conversion time)
+#define INA226_CONVERSION_US (CONFIG_INA226_AVG_SAMPLES * 2 * CONFIG_INA226_CONV_TIME_US)
+#endif
 
 // ------------------------- Data Structures -------------------------
 
@@ -20,6 +36,8 @@ typedef struct
 {
     float bus_voltage_v;
     float current_a;
+    float power_w;
+    double energy_wh; // accumulated since first boot, kept across restarts
 } ina226_data_t;
 
 // SHTC3 (Temp/Humidity)
@@ -37,6 +55,18 @@ typedef struct
     float pitch, roll;
 } mpu6050_data_t;
 
+// Orientation and movement from the attitude estimator, every 100 ms
+typedef struct
+{
+    uint64_t timestamp_us;
+    mpu6050_data_t motion; // gravity estimate (g), latest gyro, pitch and roll (deg)
+    float tilt_deg;        // angle to the reference orientation
+    bool tilted;           // tilt_deg above CONFIG_SENSOR_TILT_ALARM_DEG
+    bool moving;           // orientation changing faster than CONFIG_SENSOR_MOVE_DEG_PER_S
+    uint32_t move_events;  // moving went true, since boot
+} sensor_attitude_t;
+
+// Added to the raw counts (LSB) before scaling
 typedef struct
 {
     int32_t accel_x;
@@ -50,15 +80,191 @@ typedef struct
 // Unified synchronized sample
 typedef struct
 {
-    uint64_t timestamp_us;
+    uint64_t timestamp_us; // reconstructed from the FIFO sample clock
+    uint32_t seq;          // raw sample sequence number; gaps mean lost samples
     float accel_x_g;
     float accel_y_g;
     float accel_z_g;
-    float latest_current_a;
-    float latest_temperature_c;
+    float latest_current_a;     // slow channels, interpolated to timestamp_us when
+    float latest_temperature_c; // the sample is handed out (NAN on the sample bus)
     float magnitude;
+#if CONFIG_MPU6050_FIFO_GYRO
+    float gyro_x_dps;
+    float gyro_y_dps;
+    float gyro_z_dps;
+#endif
+#if CONFIG_MPU6050_FIFO_TEMP
+    float die_temperature_c; // MPU6050 internal sensor, not ambient
+#endif
 } synchronized_sample_t;
 
+// Packed high-rate record for long captures: raw accel counts plus the time
+// since the previous record. 8 bytes instead of sizeof(synchronized_sample_t).
+typedef struct __attribute__((packed))
+{
+    int16_t accel_x;
+    int16_t accel_y;
+    int16_t accel_z;
+    uint16_t dt_us; // saturates at 65535 across gaps
+} sensor_raw_record_t;
+
+// Samples lost to a FIFO overflow keep their sequence numbers in the history
+// as records with every axis at this value. A real sample never has all three
+// axes at negative full scale; the history nudges one if it does.
+#define SENSOR_RAW_LOST INT16_MIN
+
+// Slow channels are stored as change events next to the raw records
+typedef enum
+{
+    SENSOR_SLOW_CURRENT = 0,
+    SENSOR_SLOW_TEMPERATURE,
+    SENSOR_SLOW_CHANNELS,
+} sensor_slow_channel_t;
+
+typedef struct
+{
+    uint32_t seq;    // first raw record the value applies to
+    uint8_t channel; // sensor_slow_channel_t
+    float value;
+} sensor_slow_event_t;
+
+// Vibration spectrum of the accel magnitude
+typedef struct
+{
+    float freq_hz;
+    float amplitude_g; // single-sided peak amplitude
+} sensor_spectrum_peak_t;
+
+typedef struct
+{
+    uint64_t timestamp_us; // newest sample in the FFT frame
+    float rms_g;           // AC RMS of the frame (mean removed)
+    float resolution_hz;   // bin spacing
+    uint32_t compute_us;   // window + FFT + peak search time
+    uint16_t num_peaks;    // strongest first
+    sensor_spectrum_peak_t peaks[SENSOR_SPECTRUM_MAX_PEAKS];
+} sensor_spectrum_t;
+
+// Windowed vibration statistics, per accel axis (gravity/mean removed)
+typedef struct
+{
+    float rms_g;
+    float peak_g;       // largest deviation from the window mean
+    float crest_factor; // peak / rms
+    float skewness;
+    float kurtosis;     // 3 for Gaussian noise, higher for impacts
+} sensor_axis_stats_t;
+
+typedef struct
+{
+    uint64_t timestamp_us; // end of the window
+    uint32_t window_ms;
+    uint32_t samples;
+    sensor_axis_stats_t axis[3]; // x, y, z
+} sensor_vibration_stats_t;
+
+typedef enum
+{
+    SENSOR_VIB_WINDOW_SLIDING = 0, // updated every 100 ms
+    SENSOR_VIB_WINDOW_TUMBLING,    // updated once per window
+} sensor_vib_window_t;
+
+// Acquisition counters (monotonic since boot)
+typedef struct
+{
+    uint32_t i2c_transactions; // all I2C transactions issued by the sensor manager
+    uint32_t fifo_bursts;      // REG_FIFO_R_W read transactions
+    uint32_t fifo_frames;      // accel frames drained from the FIFO
+    uint32_t fifo_bytes;       // FIFO payload bytes drained
+    uint32_t isr_entries;      // MPU INT pin and watermark timer callbacks
+    uint32_t mpu_wakeups;      // mpu_task wakeups (one context switch each)
+    uint32_t isr_per_sec;      // isr_entries rate over the last second
+    uint32_t mpu_wakeups_per_sec;
+    uint32_t stream_dropped;   // real-time samples overwritten before being read
+    uint32_t batches_completed;
+    uint32_t batch_samples_dropped; // samples lost because every batch buffer was in use
+    uint32_t batch_buffers_free;    // buffers currently available to the producer
+    uint32_t fft_frames;
+    uint32_t fft_last_us;      // compute time of the latest FFT frame
+    uint32_t fft_max_us;
+    uint32_t i2c_errors;          // failed transactions, all devices
+    uint32_t i2c_mpu_wait_max_us; // longest MPU wait behind other bus traffic
+    uint32_t ina_conversions;     // INA226 results read
+    uint32_t ina_timeouts;        // conversion-ready flag not seen in time
+} sensor_manager_stats_t;
+
+// Sample bus subscription: full-rate samples, read in place
+typedef struct sensor_bus_sub *sensor_bus_sub_t;
+
+typedef struct
+{
+    uint32_t delivered;
+    uint32_t dropped; // overwritten before (or while) they were read
+    uint32_t lag;     // samples behind the newest one at the last read
+    uint32_t lag_max;
+} sensor_bus_sub_stats_t;
+
+// Sensor health (monotonic since boot)
+typedef struct
+{
+    uint32_t fifo_overflows;   // MPU FIFO overflows, each followed by a FIFO reset
+    uint32_t fifo_lost_frames; // frames lost to overflows (seen as seq gaps)
+    uint32_t resync_last_us;   // overflow detected until the next good frame
+    uint32_t resync_max_us;
+    uint64_t last_overflow_us; // esp_timer time, 0 if none
+    uint32_t i2c_errors;       // failed transactions, all devices
+    uint32_t ina_timeouts;     // INA226 conversion-ready flag not seen in time
+} sensor_health_t;
+
+// ------------------------- Conversion Helpers -------------------------
+
+static inline bool sensor_raw_record_lost(const sensor_raw_record_t *rec)
+{
+    return rec->accel_x == SENSOR_RAW_LOST && rec->accel_y == SENSOR_RAW_LOST && rec->accel_z == SENSOR_RAW_LOST;
+}
+
+static inline void sensor_raw_record_to_sample(const sensor_raw_record_t *rec, uint32_t seq, uint64_t timestamp_us,
+                                               float current_a, float temperature_c, synchronized_sample_t *out)
+{
+    out->timestamp_us = timestamp_us;
+    out->seq = seq;
+    if (sensor_raw_record_lost(rec))
+    {
+        out->accel_x_g = out->accel_y_g = out->accel_z_g = out->magnitude = NAN;
+        out->latest_current_a = current_a;
+        out->latest_temperature_c = temperature_c;
+        return;
+    }
+    out->accel_x_g = rec->accel_x / MPU_ACCEL_LSB_PER_G;
+    out->accel_y_g = rec->accel_y / MPU_ACCEL_LSB_PER_G;
+    out->accel_z_g = rec->accel_z / MPU_ACCEL_LSB_PER_G;
+    out->latest_current_a = current_a;
+    out->latest_temperature_c = temperature_c;
+    out->magnitude = sqrtf(out->accel_x_g * out->accel_x_g +
+                           out->accel_y_g * out->accel_y_g +
+                           out->accel_z_g * out->accel_z_g);
+}
+
+static inline int16_t sensor_g_to_raw(float g)
+{
+    float raw = g * MPU_ACCEL_LSB_PER_G;
+    if (raw > INT16_MAX)
+        return INT16_MAX;
+    if (raw < INT16_MIN)
+        return INT16_MIN;
+    return (int16_t)lrintf(raw);
+}
+
+static inline void sensor_sample_to_raw_record(const synchronized_sample_t *in, uint64_t prev_timestamp_us,
+                                               sensor_raw_record_t *out)
+{
+    uint64_t dt = in->timestamp_us - prev_timestamp_us;
+    out->accel_x = sensor_g_to_raw(in->accel_x_g);
+    out->accel_y = sensor_g_to_raw(in->accel_y_g);
+    out->accel_z = sensor_g_to_raw(in->accel_z_g);
+    out->dt_us = dt > UINT16_MAX ? UINT16_MAX : (uint16_t)dt;
+}
+
 // ------------------------- API -------------------------
 
 /**
@@ -67,6 +273,15 @@ typedef struct
  */
 esp_err_t sensor_manager_init(void);
 
+/**
+ * @brief Change the real-time stream rate. The anti-aliasing filter is
+ * redesigned by the capture task before the next sample.
+ * @param rate_hz Output rate; 1000 / rate_hz must be an integer that splits
+ *        into at most two factors of 10 or less (e.g. 10, 20, 25, 50, 100)
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG if the rate is not supported
+ */
+esp_err_t sensor_manager_set_stream_rate(int rate_hz);
+
 /**
  * @brief Get the next decimated sample (for real-time stream/MQTT/graphs).
  * @param out Pointer to store the sample
@@ -76,19 +291,173 @@ esp_err_t sensor_manager_init(void);
 bool sensor_manager_get_next_sample(synchronized_sample_t *out, TickType_t timeout);
 
 /**
- * @brief Get the latest full batch of samples (for AI training).
- * @param out_batch Pointer to buffer to hold the batch (must be size BATCH_SIZE)
+ * @brief Subscribe to the full-rate sample bus. Every subscriber has its own
+ * cursor, so slow consumers never hold back the others; they lose the oldest
+ * samples instead (counted in the subscriber stats).
+ * @param name Short name for logs, must outlive the subscription
+ * @param decimation Deliver every Nth sample (1 = all); no anti-alias filter
+ * @return Subscription handle, NULL if all SAMPLE_BUS_MAX_SUBSCRIBERS are taken
+ */
+sensor_bus_sub_t sensor_manager_subscribe(const char *name, uint32_t decimation);
+
+/**
+ * @brief End a subscription. Its handle must not be used afterwards.
+ */
+void sensor_manager_unsubscribe(sensor_bus_sub_t sub);
+
+/**
+ * @brief Wait for the next sample of a subscription and return a pointer into
+ * the bus, without copying. Call sensor_manager_bus_release() when done;
+ * one sample per subscriber may be held at a time. Bus samples are shared,
+ * so their slow channels are NAN; fill a copy with
+ * sensor_manager_fill_slow_channels() where they are needed.
+ * @return NULL on timeout
+ */
+const synchronized_sample_t *sensor_manager_bus_acquire(sensor_bus_sub_t sub, TickType_t timeout);
+
+/**
+ * @brief Release the sample returned by sensor_manager_bus_acquire().
+ * @return false if the sample was overwritten while it was held; anything
+ *         derived from it must then be discarded
+ */
+bool sensor_manager_bus_release(sensor_bus_sub_t sub);
+
+/**
+ * @brief Get the delivery, drop and lag counters of a subscription.
+ */
+void sensor_manager_bus_get_stats(sensor_bus_sub_t sub, sensor_bus_sub_stats_t *out);
+
+/**
+ * @brief Get the oldest full batch of samples (for AI training), zero-copy.
+ * The batch stays owned by the caller until sensor_manager_release_batch().
+ * @param out_batch Returns a pointer to the batch buffer
  * @param out_count Returns the number of samples (should always be BATCH_SIZE)
  * @param timeout Timeout ticks to wait
  * @return true if a batch was retrieved, false otherwise
  */
-bool sensor_manager_get_batch(synchronized_sample_t *out_batch, int *out_count, TickType_t timeout);
+bool sensor_manager_get_batch(const synchronized_sample_t **out_batch, int *out_count, TickType_t timeout);
+
+/**
+ * @brief Interpolate the slow channels (current, temperature) onto the
+ * timestamps of the given samples. Values are held at the newest measurement
+ * where no later one has arrived yet.
+ * @param samples Samples sorted by timestamp
+ * @param count Number of samples
+ */
+void sensor_manager_fill_slow_channels(synchronized_sample_t *samples, size_t count);
+
+/**
+ * @brief Return a batch obtained from sensor_manager_get_batch() to the pool.
+ * @param batch Batch pointer, may be NULL
+ */
+void sensor_manager_release_batch(const synchronized_sample_t *batch);
+
+/**
+ * @brief Enable or disable batch capture. Disabled by default so that the
+ * pool is not exhausted when nobody consumes batches. Disabling drops the
+ * partial batch and the completed batches not taken yet; batches already
+ * taken still have to be released.
+ */
+void sensor_manager_set_batch_capture(bool enable);
+
+/**
+ * @brief Wait for the next vibration spectrum (CONFIG_SENSOR_FFT_ENABLE).
+ * Only the newest spectrum is kept; older unread ones are replaced.
+ * @param out Pointer to sensor_spectrum_t struct
+ * @param timeout Timeout ticks to wait
+ * @return true if a spectrum was retrieved, false otherwise
+ */
+bool sensor_manager_get_spectrum(sensor_spectrum_t *out, TickType_t timeout);
+
+/**
+ * @brief Get the latest windowed vibration statistics.
+ * @param window Sliding or tumbling window result
+ * @param out Pointer to sensor_vibration_stats_t struct
+ * @return true if a complete window is available, false otherwise
+ */
+bool sensor_manager_get_vibration_stats(sensor_vib_window_t window, sensor_vibration_stats_t *out);
+
+/**
+ * @brief Get the latest power data (bus voltage, current, power, energy).
+ * Never blocks; the latest-value getters are safe from any task.
+ * @param out Pointer to ina226_data_t struct
+ * @return true once a measurement is available, false otherwise
+ */
+bool sensor_manager_get_latest_power(ina226_data_t *out);
 
 /**
- * @brief Get the latest environment data (temperature/humidity).
+ * @brief Get the latest orientation (pitch, roll) and tilt/movement state.
+ * @param out Pointer to sensor_attitude_t struct
+ * @return true once the estimator has produced a result, false otherwise
+ */
+bool sensor_manager_get_attitude(sensor_attitude_t *out);
+
+/**
+ * @brief Take the current orientation as the upright reference for the tilt
+ * check. The reference is otherwise taken automatically once the estimator
+ * has settled after boot.
+ */
+void sensor_manager_set_attitude_reference(void);
+
+/**
+ * @brief Get the latest environment data (temperature/humidity). Never blocks.
  * @param out Pointer to shtc3_data_t struct
- * @return true if valid data was retrieved, false otherwise
+ * @return true once a measurement is available, false otherwise
  */
 bool sensor_manager_get_latest_environment(shtc3_data_t *out);
 
+/**
+ * @brief Get a snapshot of the acquisition counters.
+ * @param out Pointer to sensor_manager_stats_t struct
+ * @return true if the snapshot was written, false otherwise
+ */
+bool sensor_manager_get_stats(sensor_manager_stats_t *out);
+
+/**
+ * @brief Get the sensor health counters (FIFO overflows and recovery, bus errors).
+ * @param out Pointer to sensor_health_t struct
+ * @return true if the snapshot was written, false otherwise
+ */
+bool sensor_manager_get_health(sensor_health_t *out);
+
+/**
+ * @brief Get the range of sequence numbers held in the PSRAM history.
+ * @param oldest_seq Returns the oldest readable sequence number
+ * @param next_seq Returns the sequence number the next sample will get
+ * @return false if the history is disabled
+ */
+bool sensor_manager_get_history_range(uint32_t *oldest_seq, uint32_t *next_seq);
+
+/**
+ * @brief Copy packed raw records from the history. Samples lost to a FIFO
+ * overflow come back as SENSOR_RAW_LOST records.
+ * @return Number of records copied; 0 if start_seq has been overwritten or not captured yet
+ */
+size_t sensor_manager_read_history_raw(uint32_t start_seq, sensor_raw_record_t *out, size_t max_count);
+
+/**
+ * @brief Rebuild full samples from the history, including timestamps and the
+ * slow channels in effect at each sample. Samples lost to a FIFO overflow
+ * have NAN acceleration.
+ * @return Number of samples written; 0 if start_seq has been overwritten or not captured yet
+ */
+size_t sensor_manager_read_history(uint32_t start_seq, synchronized_sample_t *out, size_t max_count);
+
+/**
+ * @brief Recalibrate the MPU6050 offsets on the next
+ * CONFIG_MPU6050_CALIBRATION_SAMPLES frames and store them in NVS.
+ * The device must lie flat and still until the new offsets are logged.
+ * @return ESP_ERR_NOT_SUPPORTED without CONFIG_MPU6050_CALIBRATE_ON_START
+ */
+esp_err_t sensor_manager_calibrate_mpu(void);
+
+/**
+ * @brief Write the recorded sensor transport trace (every I2C transaction and
+ * MPU wake event since boot) to a stream, e.g. a file on SD card or SPIFFS.
+ * Requires CONFIG_SENSOR_HAL_RECORD; the trace can be replayed with the
+ * replay transport backend.
+ * @return ESP_ERR_NOT_SUPPORTED if recording is disabled
+ */
+esp_err_t sensor_manager_write_trace(FILE *f);
+
 #endif // SENSOR_MANAGER_H
@@ -0,0 +1,87 @@
+#include "resampler.h"
+#include <math.h>
+#include <string.h>
+
+#define RESAMPLER_MASK (RESAMPLER_POINTS - 1)
+
+void resampler_init(resampler_t *r)
+{
+    memset(r->points, 0, sizeof(r->points));
+    for (int c = 0; c < SENSOR_SLOW_CHANNELS; c++)
+        atomic_init(&r->head[c], 0);
+}
+
+void resampler_add(resampler_t *r, sensor_slow_channel_t channel, uint64_t timestamp_us, float value)
+{
+    uint32_t idx = atomic_load_explicit(&r->head[channel], memory_order_relaxed);
+    resampler_point_t *p = &r->points[channel][idx & RESAMPLER_MASK];
+    p->timestamp_us = timestamp_us;
+    p->value = value;
+    atomic_store_explicit(&r->head[channel], idx + 1, memory_order_release);
+}
+
+// Copy the stored points of a channel, oldest first. The slot the writer
+// fills next is left out, so the copy is consistent unless another point
+// was published meanwhile.
+static size_t resampler_snapshot(const resampler_t *r, sensor_slow_channel_t channel, resampler_point_t *out)
+{
+    for (;;)
+    {
+        uint32_t head = atomic_load_explicit(&r->head[channel], memory_order_acquire);
+        uint32_t n = head < RESAMPLER_POINTS ? head : RESAMPLER_POINTS - 1;
+        for (uint32_t i = 0; i < n; i++)
+            out[i] = r->points[channel][(head - n + i) & RESAMPLER_MASK];
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&r->head[channel], memory_order_relaxed) == head)
+            return n;
+    }
+}
+
+bool resampler_latest(const resampler_t *r, sensor_slow_channel_t channel, resampler_point_t *out)
+{
+    for (;;)
+    {
+        uint32_t head = atomic_load_explicit(&r->head[channel], memory_order_acquire);
+        if (head == 0)
+            return false;
+        *out = r->points[channel][(head - 1) & RESAMPLER_MASK];
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&r->head[channel], memory_order_relaxed) == head)
+            return true;
+    }
+}
+
+void resampler_fill(const resampler_t *r, synchronized_sample_t *samples, size_t count)
+{
+    resampler_point_t pts[RESAMPLER_POINTS];
+    for (int c = 0; c < SENSOR_SLOW_CHANNELS; c++)
+    {
+        size_t n = resampler_snapshot(r, (sensor_slow_channel_t)c, pts);
+        size_t k = 0; // first point after the current sample
+        for (size_t i = 0; i < count; i++)
+        {
+            uint64_t t = samples[i].timestamp_us;
+            while (k < n && pts[k].timestamp_us <= t)
+                k++;
+
+            float v;
+            if (n == 0)
+                v = NAN; // no measurement yet: null in JSON, BATCH_CODEC_NAN in batches
+            else if (k == 0)
+                v = pts[0].value; // older than anything stored
+            else if (k == n)
+                v = pts[n - 1].value; // next measurement not in yet
+            else
+            {
+                const resampler_point_t *a = &pts[k - 1], *b = &pts[k];
+                float f = (float)(t - a->timestamp_us) / (float)(b->timestamp_us - a->timestamp_us);
+                v = a->value + f * (b->value - a->value);
+            }
+
+            if (c == SENSOR_SLOW_CURRENT)
+                samples[i].latest_current_a = v;
+            else
+                samples[i].latest_temperature_c = v;
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include "sensor_manager.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Slow channels (INA226 current, SHTC3 temperature) resampled onto the accel
+// sample clock. Producers only append timestamped points; nothing happens per
+// accel sample. Consumers interpolate linearly between the two points around
+// each sample timestamp when they ask for merged samples, and hold the newest
+// (oldest) value outside the stored range. One writer per channel, any number
+// of readers, no locks: a reader that raced with the writer simply retries.
+
+// A consumer may fill a batch as late as when the whole pool is queued behind
+// the batch being captured. The channel that updates fastest (the INA226 task
+// reads at most once per tick) must still have points that far back, plus
+// one on either side to interpolate between and the slot being written.
+#define RESAMPLER_WINDOW_US \
+    ((CONFIG_SENSOR_BATCH_POOL_BUFFERS + 1) * (uint64_t)BATCH_SIZE * 1000000 / SENSOR_SAMPLE_RATE_HZ)
+#if CONFIG_ENABLE_INA226
+#define RESAMPLER_INA226_PERIOD_US \
+    (INA226_CONVERSION_US > 1000000 / configTICK_RATE_HZ ? INA226_CONVERSION_US : 1000000 / configTICK_RATE_HZ)
+#else
+#define RESAMPLER_INA226_PERIOD_US UINT32_MAX
+#endif
+#if CONFIG_ENABLE_SHTC3
+#define RESAMPLER_SHTC3_PERIOD_US (CONFIG_SHTC3_INTERVAL_MS * 1000)
+#else
+#define RESAMPLER_SHTC3_PERIOD_US UINT32_MAX
+#endif
+#define RESAMPLER_MIN_PERIOD_US \
+    (RESAMPLER_INA226_PERIOD_US < RESAMPLER_SHTC3_PERIOD_US ? RESAMPLER_INA226_PERIOD_US : RESAMPLER_SHTC3_PERIOD_US)
+#define RESAMPLER_MIN_POINTS (RESAMPLER_WINDOW_US / RESAMPLER_MIN_PERIOD_US + 3)
+
+// Per channel, power of two. resampler_fill copies a channel onto the stack,
+// which caps it at 128 points (2 KB).
+#define RESAMPLER_POINTS (RESAMPLER_MIN_POINTS <= 32 ? 32 : RESAMPLER_MIN_POINTS <= 64 ? 64 : 128)
+_Static_assert(RESAMPLER_MIN_POINTS <= RESAMPLER_POINTS,
+               "INA226 results come too fast for the batch pool to be resampled: raise the INA226 "
+               "averaging or conversion time, or use fewer batch buffers");
+
+typedef struct
+{
+    uint64_t timestamp_us; // middle of the measurement, esp_timer time
+    float value;
+} resampler_point_t;
+
+typedef struct
+{
+    resampler_point_t points[SENSOR_SLOW_CHANNELS][RESAMPLER_POINTS];
+    atomic_uint head[SENSOR_SLOW_CHANNELS]; // points ever added
+} resampler_t;
+
+void resampler_init(resampler_t *r);
+
+/**
+ * @brief Add a measurement. Timestamps must increase per channel.
+ */
+void resampler_add(resampler_t *r, sensor_slow_channel_t channel, uint64_t timestamp_us, float value);
+
+/**
+ * @brief Number of points ever added to a channel (changes on every add).
+ */
+static inline uint32_t resampler_count(const resampler_t *r, sensor_slow_channel_t channel)
+{
+    return atomic_load_explicit(&r->head[channel], memory_order_acquire);
+}
+
+/**
+ * @brief Get the newest point of a channel.
+ * @return false if the channel has no points yet
+ */
+bool resampler_latest(const resampler_t *r, sensor_slow_channel_t channel, resampler_point_t *out);
+
+/**
+ * @brief Fill latest_current_a and latest_temperature_c of samples sorted by
+ * timestamp (as every sample source delivers them). A channel with no
+ * measurement yet fills NAN.
+ */
+void resampler_fill(const resampler_t *r, synchronized_sample_t *samples, size_t count);
+
+#endif // RESAMPLER_H
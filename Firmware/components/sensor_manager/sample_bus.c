@@ -0,0 +1,159 @@
+#include "sample_bus.h"
+#include "esp_heap_caps.h"
+#include <string.h>
+
+static portMUX_TYPE subs_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t round_up_pow2(uint32_t v)
+{
+    uint32_t p = 1;
+    while (p < v)
+        p <<= 1;
+    return p;
+}
+
+esp_err_t sample_bus_init(sample_bus_t *bus, uint32_t capacity)
+{
+    capacity = round_up_pow2(capacity);
+    memset(bus, 0, sizeof(*bus));
+    bus->slots = heap_caps_calloc(capacity, sizeof(sample_bus_slot_t), MALLOC_CAP_SPIRAM);
+    if (!bus->slots)
+        bus->slots = heap_caps_calloc(capacity, sizeof(sample_bus_slot_t), MALLOC_CAP_DEFAULT);
+    bus->events = xEventGroupCreate();
+    if (!bus->slots || !bus->events)
+        return ESP_ERR_NO_MEM;
+
+    bus->mask = capacity - 1;
+    atomic_init(&bus->head, 0);
+    for (uint32_t i = 0; i < capacity; i++)
+        atomic_init(&bus->slots[i].seq, 0);
+    for (int i = 0; i < SAMPLE_BUS_MAX_SUBSCRIBERS; i++)
+    {
+        bus->subs[i].bus = bus;
+        bus->subs[i].bit = 1u << i;
+    }
+    return ESP_OK;
+}
+
+void sample_bus_publish(sample_bus_t *bus, const synchronized_sample_t *sample)
+{
+    uint32_t idx = atomic_load_explicit(&bus->head, memory_order_relaxed);
+    sample_bus_slot_t *slot = &bus->slots[idx & bus->mask];
+
+    atomic_store_explicit(&slot->seq, 2 * idx + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->sample = *sample;
+    atomic_store_explicit(&slot->seq, 2 * idx + 2, memory_order_release);
+
+    atomic_store_explicit(&bus->head, idx + 1, memory_order_release);
+}
+
+void sample_bus_notify(sample_bus_t *bus)
+{
+    EventBits_t bits = 0;
+    for (int i = 0; i < SAMPLE_BUS_MAX_SUBSCRIBERS; i++)
+        if (bus->subs[i].active)
+            bits |= bus->subs[i].bit;
+    if (bits)
+        xEventGroupSetBits(bus->events, bits);
+}
+
+sensor_bus_sub_t sample_bus_subscribe(sample_bus_t *bus, const char *name, uint32_t decimation)
+{
+    sensor_bus_sub_t sub = NULL;
+    portENTER_CRITICAL(&subs_lock);
+    for (int i = 0; i < SAMPLE_BUS_MAX_SUBSCRIBERS; i++)
+    {
+        if (!bus->subs[i].active)
+        {
+            sub = &bus->subs[i];
+            sub->name = name;
+            sub->decimation = decimation ? decimation : 1;
+            sub->cursor = atomic_load_explicit(&bus->head, memory_order_acquire);
+            sub->held_seq = 0;
+            memset(&sub->stats, 0, sizeof(sub->stats));
+            sub->active = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&subs_lock);
+    if (sub)
+        xEventGroupClearBits(bus->events, sub->bit);
+    return sub;
+}
+
+void sample_bus_unsubscribe(sensor_bus_sub_t sub)
+{
+    portENTER_CRITICAL(&subs_lock);
+    sub->active = false;
+    portEXIT_CRITICAL(&subs_lock);
+}
+
+const synchronized_sample_t *sample_bus_acquire(sensor_bus_sub_t sub, TickType_t timeout)
+{
+    sample_bus_t *bus = sub->bus;
+    uint32_t capacity = bus->mask + 1;
+    TickType_t start = xTaskGetTickCount();
+
+    for (;;)
+    {
+        uint32_t head = atomic_load_explicit(&bus->head, memory_order_acquire);
+        if ((int32_t)(head - sub->cursor) <= 0)
+        {
+            TickType_t wait = portMAX_DELAY;
+            if (timeout != portMAX_DELAY)
+            {
+                TickType_t elapsed = xTaskGetTickCount() - start;
+                if (elapsed >= timeout)
+                    return NULL;
+                wait = timeout - elapsed;
+            }
+            // The bit may be stale from samples already read; loop
+            xEventGroupWaitBits(bus->events, sub->bit, pdTRUE, pdFALSE, wait);
+            continue;
+        }
+
+        // Lapped by the producer: jump to the oldest sample still in the
+        // ring that is on this subscriber's decimation grid
+        uint32_t lag = head - sub->cursor;
+        if (lag > capacity)
+        {
+            uint32_t skip = (lag - capacity + sub->decimation - 1) / sub->decimation;
+            sub->stats.dropped += skip;
+            sub->cursor += skip * sub->decimation;
+            lag = head - sub->cursor;
+        }
+        sub->stats.lag = lag;
+        if (lag > sub->stats.lag_max)
+            sub->stats.lag_max = lag;
+
+        sample_bus_slot_t *slot = &bus->slots[sub->cursor & bus->mask];
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq == 2 * sub->cursor + 2)
+        {
+            sub->held_seq = seq;
+            return &slot->sample;
+        }
+
+        // Being overwritten right now
+        sub->stats.dropped++;
+        sub->cursor += sub->decimation;
+    }
+}
+
+bool sample_bus_release(sensor_bus_sub_t sub)
+{
+    if (!sub->held_seq)
+        return false;
+
+    sample_bus_slot_t *slot = &sub->bus->slots[sub->cursor & sub->bus->mask];
+    atomic_thread_fence(memory_order_acquire);
+    bool intact = atomic_load_explicit(&slot->seq, memory_order_relaxed) == sub->held_seq;
+    if (intact)
+        sub->stats.delivered++;
+    else
+        sub->stats.dropped++;
+    sub->held_seq = 0;
+    sub->cursor += sub->decimation;
+    return intact;
+}
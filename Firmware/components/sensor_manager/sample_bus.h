@@ -0,0 +1,80 @@
+#ifndef SAMPLE_BUS_H
+#define SAMPLE_BUS_H
+
+#include "sensor_manager.h"
+#include "freertos/event_groups.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Full-rate publish/subscribe bus. One ring holds the newest samples; every
+// subscriber has its own read cursor and decimation factor and reads the
+// samples in place. The producer never waits for anyone: a subscriber that
+// falls more than a ring behind loses the overwritten samples, which are
+// counted per subscriber. Slots carry the same sequence word as sample_ring,
+// so a reader can tell whether a slot was overwritten while it used it.
+
+#define SAMPLE_BUS_MAX_SUBSCRIBERS 8
+
+typedef struct
+{
+    atomic_uint seq; // 2*index+1 while being written, 2*index+2 once valid
+    synchronized_sample_t sample;
+} sample_bus_slot_t;
+
+typedef struct sample_bus sample_bus_t;
+
+struct sensor_bus_sub
+{
+    sample_bus_t *bus;
+    const char *name;
+    uint32_t decimation;
+    uint32_t cursor;   // next sample index to read
+    uint32_t held_seq; // sequence word of the slot handed out, 0 if none
+    EventBits_t bit;
+    bool active;
+    sensor_bus_sub_stats_t stats;
+};
+
+struct sample_bus
+{
+    sample_bus_slot_t *slots;
+    uint32_t mask;    // capacity - 1
+    atomic_uint head; // samples ever published
+    EventGroupHandle_t events; // one bit per subscriber, set on publish
+    struct sensor_bus_sub subs[SAMPLE_BUS_MAX_SUBSCRIBERS];
+};
+
+/**
+ * @brief Allocate the ring (PSRAM preferred).
+ * @param capacity Minimum number of samples, rounded up to a power of two
+ */
+esp_err_t sample_bus_init(sample_bus_t *bus, uint32_t capacity);
+
+/**
+ * @brief Append a sample, overwriting the oldest. Producer only, never blocks.
+ * Subscribers are woken by sample_bus_notify().
+ */
+void sample_bus_publish(sample_bus_t *bus, const synchronized_sample_t *sample);
+
+/**
+ * @brief Wake every subscriber; called once per batch of published samples.
+ */
+void sample_bus_notify(sample_bus_t *bus);
+
+sensor_bus_sub_t sample_bus_subscribe(sample_bus_t *bus, const char *name, uint32_t decimation);
+void sample_bus_unsubscribe(sensor_bus_sub_t sub);
+
+/**
+ * @brief Wait for the next sample of a subscription and return it in place.
+ * @return NULL on timeout
+ */
+const synchronized_sample_t *sample_bus_acquire(sensor_bus_sub_t sub, TickType_t timeout);
+
+/**
+ * @brief Finish with the sample returned by sample_bus_acquire().
+ * @return false if the producer overwrote it in the meantime
+ */
+bool sample_bus_release(sensor_bus_sub_t sub);
+
+#endif // SAMPLE_BUS_H
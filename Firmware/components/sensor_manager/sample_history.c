@@ -0,0 +1,240 @@
+#include "sample_history.h"
+#include "esp_heap_caps.h"
+#include <math.h>
+#include <string.h>
+
+// INA226 once per conversion (at most once per tick) + SHTC3 once per interval
+#if CONFIG_ENABLE_INA226
+#define INA226_UPDATES_PER_SECOND (1000000 / INA226_CONVERSION_US + 1)
+#else
+#define INA226_UPDATES_PER_SECOND 0
+#endif
+#if CONFIG_ENABLE_SHTC3
+#define SHTC3_UPDATES_PER_SECOND (1000 / CONFIG_SHTC3_INTERVAL_MS + 1)
+#else
+#define SHTC3_UPDATES_PER_SECOND 0
+#endif
+#define SLOW_EVENTS_PER_SECOND                                                                   \
+    ((INA226_UPDATES_PER_SECOND < configTICK_RATE_HZ ? INA226_UPDATES_PER_SECOND : configTICK_RATE_HZ) + \
+     SHTC3_UPDATES_PER_SECOND)
+
+static uint32_t round_up_pow2(uint32_t v)
+{
+    uint32_t p = 1;
+    while (p < v)
+        p <<= 1;
+    return p;
+}
+
+static void *history_alloc(size_t size)
+{
+    void *p = heap_caps_calloc(1, size, MALLOC_CAP_SPIRAM);
+    return p ? p : heap_caps_calloc(1, size, MALLOC_CAP_DEFAULT);
+}
+
+esp_err_t sample_history_init(sample_history_t *h, uint32_t records)
+{
+    uint32_t capacity = round_up_pow2(records < SAMPLE_HISTORY_KEYFRAME_INTERVAL ? SAMPLE_HISTORY_KEYFRAME_INTERVAL : records);
+    // One change per slow channel update over the whole span, plus the refreshes
+    uint32_t event_capacity = round_up_pow2((capacity / 1000 + 1) * SLOW_EVENTS_PER_SECOND + 4 * SENSOR_SLOW_CHANNELS);
+
+    memset(h, 0, sizeof(*h));
+    h->records = history_alloc(capacity * sizeof(sensor_raw_record_t));
+    h->keyframes = history_alloc((capacity / SAMPLE_HISTORY_KEYFRAME_INTERVAL) * sizeof(uint64_t));
+    h->events = history_alloc(event_capacity * sizeof(sensor_slow_event_t));
+    if (!h->records || !h->keyframes || !h->events)
+    {
+        heap_caps_free(h->records);
+        heap_caps_free(h->keyframes);
+        heap_caps_free(h->events);
+        memset(h, 0, sizeof(*h));
+        return ESP_ERR_NO_MEM;
+    }
+
+    h->mask = capacity - 1;
+    h->event_mask = event_capacity - 1;
+    atomic_init(&h->head, 0);
+    atomic_init(&h->stored, 0);
+    atomic_init(&h->event_head, 0);
+    atomic_init(&h->events_stored, 0);
+    for (int c = 0; c < SENSOR_SLOW_CHANNELS; c++)
+        h->last_value[c] = NAN;
+    return ESP_OK;
+}
+
+static void history_store(sample_history_t *h, uint32_t seq, int16_t ax, int16_t ay, int16_t az,
+                          uint64_t timestamp_us)
+{
+    uint32_t stored = atomic_load_explicit(&h->stored, memory_order_relaxed);
+    uint64_t dt = stored ? timestamp_us - h->last_timestamp_us : 0;
+    sensor_raw_record_t *rec = &h->records[seq & h->mask];
+    rec->accel_x = ax;
+    rec->accel_y = ay;
+    rec->accel_z = az;
+    rec->dt_us = dt > UINT16_MAX ? UINT16_MAX : (uint16_t)dt;
+
+    if ((seq & (SAMPLE_HISTORY_KEYFRAME_INTERVAL - 1)) == 0)
+        h->keyframes[(seq & h->mask) / SAMPLE_HISTORY_KEYFRAME_INTERVAL] = timestamp_us;
+
+    h->last_timestamp_us = timestamp_us;
+    atomic_store_explicit(&h->head, seq + 1, memory_order_release);
+    // After head, so a reader that sees the new count also sees the new head
+    if (stored <= h->mask)
+        atomic_store_explicit(&h->stored, stored + 1, memory_order_release);
+}
+
+// Sequence numbers skipped by an overflow still get records, so a read never
+// walks through stale ones. Interpolated timestamps keep the keyframes and
+// the dt chain exact on the far side of the gap.
+static void history_fill_lost(sample_history_t *h, uint32_t from, uint32_t to, uint64_t timestamp_us)
+{
+    uint32_t n = to - from;
+    uint64_t t0 = atomic_load_explicit(&h->stored, memory_order_relaxed) ? h->last_timestamp_us : timestamp_us;
+    uint64_t span = timestamp_us - t0;
+    uint32_t skip = n > h->mask + 1 ? n - (h->mask + 1) : 0; // only the last lap survives
+    for (uint32_t i = skip; i < n; i++)
+        history_store(h, from + i, SENSOR_RAW_LOST, SENSOR_RAW_LOST, SENSOR_RAW_LOST,
+                      t0 + span * (i + 1) / (n + 1));
+}
+
+void sample_history_append(sample_history_t *h, uint32_t seq, int16_t ax, int16_t ay, int16_t az,
+                           uint64_t timestamp_us)
+{
+    uint32_t head = atomic_load_explicit(&h->head, memory_order_relaxed);
+    if ((int32_t)(seq - head) > 0)
+        history_fill_lost(h, head, seq, timestamp_us);
+
+    if (ax == SENSOR_RAW_LOST && ay == SENSOR_RAW_LOST && az == SENSOR_RAW_LOST)
+        az++;
+    history_store(h, seq, ax, ay, az, timestamp_us);
+}
+
+void sample_history_update_slow(sample_history_t *h, uint32_t seq, sensor_slow_channel_t channel, float value)
+{
+    // Re-log unchanged values once per half history span so every readable
+    // range still has a starting value for each channel
+    if (value == h->last_value[channel] && seq - h->last_event_seq[channel] < (h->mask + 1) / 2)
+        return;
+
+    uint32_t idx = atomic_load_explicit(&h->event_head, memory_order_relaxed);
+    sensor_slow_event_t *ev = &h->events[idx & h->event_mask];
+    ev->seq = seq;
+    ev->channel = channel;
+    ev->value = value;
+    h->last_value[channel] = value;
+    h->last_event_seq[channel] = seq;
+    atomic_store_explicit(&h->event_head, idx + 1, memory_order_release);
+    uint32_t stored = atomic_load_explicit(&h->events_stored, memory_order_relaxed);
+    if (stored <= h->event_mask)
+        atomic_store_explicit(&h->events_stored, stored + 1, memory_order_release);
+}
+
+void sample_history_range(const sample_history_t *h, uint32_t *oldest_seq, uint32_t *next_seq)
+{
+    // Sequence numbers wrap (after about 5 days at 10 kHz), so the oldest
+    // record is head minus what is stored, never compared to head directly
+    uint32_t stored = atomic_load_explicit(&h->stored, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&h->head, memory_order_acquire);
+    uint32_t oldest = head - stored;
+
+    // Reads start from a keyframe, so the oldest usable record is the first
+    // one whose keyframe is still in the buffer
+    oldest = (oldest + SAMPLE_HISTORY_KEYFRAME_INTERVAL - 1) & ~(uint32_t)(SAMPLE_HISTORY_KEYFRAME_INTERVAL - 1);
+    *oldest_seq = oldest;
+    *next_seq = head;
+}
+
+// Clamp [start_seq, start_seq + max_count) to what is stored right now
+static size_t history_clamp(const sample_history_t *h, uint32_t start_seq, size_t max_count)
+{
+    uint32_t oldest, next;
+    sample_history_range(h, &oldest, &next);
+    if ((int32_t)(start_seq - oldest) < 0 || (int32_t)(next - start_seq) <= 0)
+        return 0;
+    uint32_t available = next - start_seq;
+    return max_count < available ? max_count : available;
+}
+
+// True if nothing at or after start_seq was overwritten while we were reading
+static bool history_still_valid(const sample_history_t *h, uint32_t start_seq)
+{
+    uint32_t oldest, next;
+    sample_history_range(h, &oldest, &next);
+    uint32_t first = start_seq & ~(uint32_t)(SAMPLE_HISTORY_KEYFRAME_INTERVAL - 1);
+    return (int32_t)(first - (next - (h->mask + 1))) >= 0 ||
+           atomic_load_explicit(&h->stored, memory_order_relaxed) <= h->mask; // nothing overwritten yet
+}
+
+size_t sample_history_read_raw(const sample_history_t *h, uint32_t start_seq, sensor_raw_record_t *out, size_t max_count)
+{
+    size_t count = history_clamp(h, start_seq, max_count);
+    for (size_t i = 0; i < count; i++)
+        out[i] = h->records[(start_seq + i) & h->mask];
+    return history_still_valid(h, start_seq) ? count : 0;
+}
+
+// Find the latest value of each slow channel at or before seq and the index
+// of the first event after it
+static uint32_t history_slow_values_at(const sample_history_t *h, uint32_t seq, float *values)
+{
+    uint32_t stored = atomic_load_explicit(&h->events_stored, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&h->event_head, memory_order_acquire);
+    uint32_t oldest = head - stored;
+    uint32_t next = head;
+    int missing = SENSOR_SLOW_CHANNELS;
+
+    for (int c = 0; c < SENSOR_SLOW_CHANNELS; c++)
+        values[c] = NAN; // no event logged for this channel yet
+    bool found[SENSOR_SLOW_CHANNELS] = {false};
+
+    for (uint32_t i = head; i != oldest && missing > 0; i--)
+    {
+        const sensor_slow_event_t *ev = &h->events[(i - 1) & h->event_mask];
+        if ((int32_t)(ev->seq - seq) > 0)
+        {
+            next = i - 1;
+            continue;
+        }
+        if (!found[ev->channel])
+        {
+            found[ev->channel] = true;
+            values[ev->channel] = ev->value;
+            missing--;
+        }
+    }
+    return next;
+}
+
+size_t sample_history_read(const sample_history_t *h, uint32_t start_seq, synchronized_sample_t *out, size_t max_count)
+{
+    size_t count = history_clamp(h, start_seq, max_count);
+    if (count == 0)
+        return 0;
+
+    // Walk forward from the keyframe to rebuild the first timestamp
+    uint32_t seq = start_seq & ~(uint32_t)(SAMPLE_HISTORY_KEYFRAME_INTERVAL - 1);
+    uint64_t t = h->keyframes[(seq & h->mask) / SAMPLE_HISTORY_KEYFRAME_INTERVAL];
+    for (seq++; seq != start_seq + 1; seq++)
+        t += h->records[seq & h->mask].dt_us;
+
+    float slow[SENSOR_SLOW_CHANNELS];
+    uint32_t ev = history_slow_values_at(h, start_seq, slow);
+    uint32_t ev_head = atomic_load_explicit(&h->event_head, memory_order_acquire);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t s = start_seq + i;
+        const sensor_raw_record_t *rec = &h->records[s & h->mask];
+        if (i > 0)
+            t += rec->dt_us;
+
+        for (; ev != ev_head && (int32_t)(h->events[ev & h->event_mask].seq - s) <= 0; ev++)
+        {
+            const sensor_slow_event_t *e = &h->events[ev & h->event_mask];
+            slow[e->channel] = e->value;
+        }
+
+        sensor_raw_record_to_sample(rec, s, t, slow[SENSOR_SLOW_CURRENT], slow[SENSOR_SLOW_TEMPERATURE], &out[i]);
+    }
+    return history_still_valid(h, start_seq) ? count : 0;
+}
@@ -0,0 +1,67 @@
+#ifndef SAMPLE_HISTORY_H
+#define SAMPLE_HISTORY_H
+
+#include "sensor_manager.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Long-term 1 kHz history in PSRAM. Accel samples are kept as packed
+// sensor_raw_record_t indexed by sequence number; slow channels are logged
+// only when they change. Single writer (mpu_task), any number of readers.
+
+#define SAMPLE_HISTORY_KEYFRAME_INTERVAL 256 // absolute timestamp every N records
+
+typedef struct
+{
+    sensor_raw_record_t *records;   // capacity entries
+    uint64_t *keyframes;            // capacity / KEYFRAME_INTERVAL entries
+    sensor_slow_event_t *events;    // event_capacity entries
+    uint32_t mask;                  // capacity - 1
+    uint32_t event_mask;            // event_capacity - 1
+    atomic_uint head;               // next record sequence number
+    atomic_uint stored;             // records below head that are valid, up to capacity
+    atomic_uint event_head;         // next event index (wraps)
+    atomic_uint events_stored;      // events below event_head that are valid, up to event_capacity
+    uint64_t last_timestamp_us;     // writer only
+    float last_value[SENSOR_SLOW_CHANNELS];
+    uint32_t last_event_seq[SENSOR_SLOW_CHANNELS];
+} sample_history_t;
+
+/**
+ * @brief Allocate the history buffers (PSRAM preferred).
+ * @param records Minimum number of records to keep, rounded up to a power of two
+ * @return ESP_OK or ESP_ERR_NO_MEM
+ */
+esp_err_t sample_history_init(sample_history_t *h, uint32_t records);
+
+/**
+ * @brief Append one accel record. If seq skips ahead, the skipped sequence
+ * numbers are stored as SENSOR_RAW_LOST records spread over the time gap.
+ */
+void sample_history_append(sample_history_t *h, uint32_t seq, int16_t ax, int16_t ay, int16_t az,
+                           uint64_t timestamp_us);
+
+/**
+ * @brief Log a slow-channel value; only changes (or periodic refreshes) are stored.
+ */
+void sample_history_update_slow(sample_history_t *h, uint32_t seq, sensor_slow_channel_t channel, float value);
+
+/**
+ * @brief Oldest and next sequence numbers that can currently be read.
+ */
+void sample_history_range(const sample_history_t *h, uint32_t *oldest_seq, uint32_t *next_seq);
+
+/**
+ * @brief Copy raw records starting at start_seq.
+ * @return Number of records copied; 0 if start_seq is no longer (or not yet) stored
+ */
+size_t sample_history_read_raw(const sample_history_t *h, uint32_t start_seq, sensor_raw_record_t *out, size_t max_count);
+
+/**
+ * @brief Rebuild full samples (timestamps and slow channels) starting at start_seq.
+ * @return Number of samples written; 0 if start_seq is no longer (or not yet) stored
+ */
+size_t sample_history_read(const sample_history_t *h, uint32_t start_seq, synchronized_sample_t *out, size_t max_count);
+
+#endif // SAMPLE_HISTORY_H
@@ -0,0 +1,67 @@
+#include "sample_ring.h"
+#include <string.h>
+
+void sample_ring_init(sample_ring_t *ring, sample_ring_slot_t *slots, uint32_t capacity)
+{
+    ring->slots = slots;
+    ring->mask = capacity - 1;
+    ring->tail = 0;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->dropped, 0);
+    for (uint32_t i = 0; i < capacity; i++)
+        atomic_init(&slots[i].seq, 0);
+}
+
+void sample_ring_push(sample_ring_t *ring, const synchronized_sample_t *sample)
+{
+    uint32_t idx = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    sample_ring_slot_t *slot = &ring->slots[idx & ring->mask];
+
+    atomic_store_explicit(&slot->seq, 2 * idx + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->sample = *sample;
+    atomic_store_explicit(&slot->seq, 2 * idx + 2, memory_order_release);
+
+    atomic_store_explicit(&ring->head, idx + 1, memory_order_release);
+}
+
+bool sample_ring_pop(sample_ring_t *ring, synchronized_sample_t *out)
+{
+    for (;;)
+    {
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        uint32_t tail = ring->tail;
+        if (head == tail)
+            return false;
+
+        // Lapped by the producer: skip to the oldest slot still in the ring
+        uint32_t capacity = ring->mask + 1;
+        if (head - tail > capacity)
+        {
+            atomic_fetch_add_explicit(&ring->dropped, head - tail - capacity, memory_order_relaxed);
+            tail = head - capacity;
+        }
+
+        sample_ring_slot_t *slot = &ring->slots[tail & ring->mask];
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq == 2 * tail + 2)
+        {
+            memcpy(out, &slot->sample, sizeof(*out));
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&slot->seq, memory_order_relaxed) == seq)
+            {
+                ring->tail = tail + 1;
+                return true;
+            }
+        }
+
+        // Overwritten before or while we copied it; count it and retry
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        ring->tail = tail + 1;
+    }
+}
+
+uint32_t sample_ring_dropped(const sample_ring_t *ring)
+{
+    return atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+}
@@ -0,0 +1,55 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include "sensor_manager.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Lock-free single-producer/single-consumer ring with an overwrite-oldest
+// policy. The producer never waits and never touches the consumer's cursor;
+// each slot carries a sequence word (seqlock style) so the consumer can tell
+// when a slot was overwritten under it and skip ahead, counting the loss.
+
+typedef struct
+{
+    atomic_uint seq; // 2*index+1 while being written, 2*index+2 once valid
+    synchronized_sample_t sample;
+} sample_ring_slot_t;
+
+typedef struct
+{
+    sample_ring_slot_t *slots;
+    uint32_t mask;    // capacity - 1
+    atomic_uint head; // samples ever pushed (producer)
+    uint32_t tail;    // samples consumed or skipped (consumer)
+    atomic_uint dropped;
+} sample_ring_t;
+
+/**
+ * @brief Initialize a ring over caller-provided storage.
+ * @param ring Ring to initialize
+ * @param slots Slot storage
+ * @param capacity Number of slots, must be a power of two
+ */
+void sample_ring_init(sample_ring_t *ring, sample_ring_slot_t *slots, uint32_t capacity);
+
+/**
+ * @brief Push a sample, overwriting the oldest one if the ring is full.
+ * Producer side only, never blocks.
+ */
+void sample_ring_push(sample_ring_t *ring, const synchronized_sample_t *sample);
+
+/**
+ * @brief Pop the oldest sample that has not been overwritten.
+ * Consumer side only, never blocks.
+ * @return true if a sample was copied to out, false if the ring is empty
+ */
+bool sample_ring_pop(sample_ring_t *ring, synchronized_sample_t *out);
+
+/**
+ * @brief Number of samples overwritten before the consumer read them.
+ */
+uint32_t sample_ring_dropped(const sample_ring_t *ring);
+
+#endif // SAMPLE_RING_H
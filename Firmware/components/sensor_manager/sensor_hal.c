@@ -0,0 +1,248 @@
+#include "sensor_hal.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+static const char *TAG = "SENSOR_HAL";
+
+// ------------------------- Globals -------------------------
+#if CONFIG_SENSOR_HAL_REPLAY
+static const sensor_hal_backend_t *backend = &sensor_hal_replay_backend;
+#elif CONFIG_SENSOR_HAL_SYNTH
+static const sensor_hal_backend_t *backend = &sensor_hal_synth_backend;
+#else
+static const sensor_hal_backend_t *backend = &sensor_hal_i2c_backend;
+#endif
+
+static sensor_hal_dev_t devices[SENSOR_HAL_MAX_DEVICES];
+static int num_devices;
+
+static sensor_hal_wake_cb_t wake_cb[SENSOR_HAL_WAKE_SOURCES];
+static void *wake_arg[SENSOR_HAL_WAKE_SOURCES];
+
+// The queued transaction in flight on each device
+typedef struct
+{
+    sensor_hal_done_cb_t done;
+    void *arg;
+#if CONFIG_SENSOR_HAL_RECORD
+    int64_t start_us;
+    uint8_t tx[SENSOR_HAL_TX_MAX];
+    size_t tx_len;
+    uint8_t *rx;
+    size_t rx_len;
+#endif
+} hal_pending_t;
+
+static hal_pending_t pending[SENSOR_HAL_MAX_DEVICES];
+
+// ------------------------- Recorder -------------------------
+#if CONFIG_SENSOR_HAL_RECORD
+// Records are appended to a PSRAM buffer until it is full; a trace with holes
+// would desynchronize the replayer, so recording simply stops there.
+static uint8_t *trace_buf;
+static size_t trace_size;
+static size_t trace_len;
+static bool trace_full;
+static uint32_t trace_dropped;
+static int64_t trace_start_us;
+static portMUX_TYPE trace_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void IRAM_ATTR trace_append(uint8_t type, uint8_t addr, esp_err_t result, int64_t t_us,
+                                   const uint8_t *tx, size_t tx_len, const uint8_t *rx, size_t rx_len)
+{
+    sensor_trace_rec_t rec = {
+        .t_us = (uint32_t)(t_us - trace_start_us),
+        .type = type,
+        .addr = addr,
+        .result = (int16_t)result,
+        .tx_len = (uint8_t)tx_len,
+        .rx_len = (uint16_t)rx_len};
+    size_t need = sizeof(rec) + tx_len + rx_len;
+
+    portENTER_CRITICAL_SAFE(&trace_lock);
+    if (trace_full || trace_len + need > trace_size)
+    {
+        trace_full = true;
+        trace_dropped++;
+    }
+    else
+    {
+        uint8_t *p = trace_buf + trace_len;
+        memcpy(p, &rec, sizeof(rec));
+        if (tx_len)
+            memcpy(p + sizeof(rec), tx, tx_len);
+        if (rx_len)
+            memcpy(p + sizeof(rec) + tx_len, rx, rx_len);
+        trace_len += need;
+    }
+    portEXIT_CRITICAL_SAFE(&trace_lock);
+}
+
+static esp_err_t trace_init(void)
+{
+    trace_size = (size_t)CONFIG_SENSOR_HAL_RECORD_KB * 1024;
+    trace_buf = heap_caps_malloc(trace_size, MALLOC_CAP_SPIRAM);
+    if (!trace_buf)
+        return ESP_ERR_NO_MEM;
+    trace_start_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "Recording sensor trace (%d KB)", CONFIG_SENSOR_HAL_RECORD_KB);
+    return ESP_OK;
+}
+#endif
+
+esp_err_t sensor_hal_trace_write(FILE *f)
+{
+#if CONFIG_SENSOR_HAL_RECORD
+    if (!trace_buf)
+        return ESP_ERR_INVALID_STATE;
+
+    // Records are only ever appended, so the prefix up to len is stable
+    portENTER_CRITICAL(&trace_lock);
+    size_t len = trace_len;
+    uint32_t dropped = trace_dropped;
+    portEXIT_CRITICAL(&trace_lock);
+
+    sensor_trace_header_t hdr = {
+        .magic = SENSOR_TRACE_MAGIC,
+        .version = SENSOR_TRACE_VERSION,
+        .start_us = trace_start_us};
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 || fwrite(trace_buf, 1, len, f) != len)
+        return ESP_FAIL;
+    if (dropped)
+        ESP_LOGW(TAG, "Trace buffer full, %lu events not recorded", (unsigned long)dropped);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+// ------------------------- Public API -------------------------
+bool IRAM_ATTR sensor_hal_deliver_wake(sensor_hal_wake_t src, int64_t time_us)
+{
+#if CONFIG_SENSOR_HAL_RECORD
+    if (trace_buf)
+        trace_append(src == SENSOR_HAL_WAKE_IRQ ? SENSOR_TRACE_WAKE_IRQ : SENSOR_TRACE_WAKE_TIMER,
+                     0, ESP_OK, time_us, NULL, 0, NULL, 0);
+#endif
+    if (!wake_cb[src])
+        return false;
+    return wake_cb[src](time_us, wake_arg[src]);
+}
+
+esp_err_t sensor_hal_transfer(sensor_hal_dev_t *dev, const uint8_t *tx, size_t tx_len,
+                              uint8_t *rx, size_t rx_len)
+{
+#if CONFIG_SENSOR_HAL_RECORD
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = backend->transfer(dev, tx, tx_len, rx, rx_len);
+    if (trace_buf)
+        trace_append(SENSOR_TRACE_I2C, dev->addr, ret, start_us, tx, tx_len, rx, rx_len);
+    return ret;
+#else
+    return backend->transfer(dev, tx, tx_len, rx, rx_len);
+#endif
+}
+
+static void submit_done(esp_err_t result, void *arg)
+{
+    sensor_hal_dev_t *dev = arg;
+    hal_pending_t *p = &pending[dev->index];
+#if CONFIG_SENSOR_HAL_RECORD
+    if (trace_buf)
+        trace_append(SENSOR_TRACE_I2C, dev->addr, result, p->start_us, p->tx, p->tx_len, p->rx, p->rx_len);
+#endif
+    p->done(result, p->arg);
+}
+
+esp_err_t sensor_hal_submit(sensor_hal_dev_t *dev, const uint8_t *tx, size_t tx_len,
+                            uint8_t *rx, size_t rx_len, sensor_hal_done_cb_t done, void *arg)
+{
+    if (tx_len > SENSOR_HAL_TX_MAX)
+        return ESP_ERR_INVALID_SIZE;
+
+    hal_pending_t *p = &pending[dev->index];
+    p->done = done;
+    p->arg = arg;
+#if CONFIG_SENSOR_HAL_RECORD
+    p->start_us = esp_timer_get_time();
+    if (tx_len)
+        memcpy(p->tx, tx, tx_len);
+    p->tx_len = tx_len;
+    p->rx = rx;
+    p->rx_len = rx_len;
+#endif
+
+    // Backends without a bus queue complete the transaction right away
+    if (!backend->submit)
+    {
+        submit_done(backend->transfer(dev, tx, tx_len, rx, rx_len), dev);
+        return ESP_OK;
+    }
+    return backend->submit(dev, tx, tx_len, rx, rx_len, submit_done, dev);
+}
+
+esp_err_t sensor_hal_add_device(uint16_t addr, uint32_t scl_hz, sensor_hal_prio_t prio,
+                                const char *name, sensor_hal_dev_t **out)
+{
+    if (num_devices >= SENSOR_HAL_MAX_DEVICES)
+        return ESP_ERR_NO_MEM;
+
+    sensor_hal_dev_t *dev = &devices[num_devices];
+    dev->index = num_devices;
+    dev->addr = addr;
+    dev->prio = prio;
+    dev->name = name;
+    dev->ctx = NULL;
+    esp_err_t ret = backend->add_device(dev, scl_hz);
+    if (ret != ESP_OK)
+        return ret;
+
+    num_devices++;
+    *out = dev;
+    return ESP_OK;
+}
+
+esp_err_t sensor_hal_attach_irq(int gpio, sensor_hal_wake_cb_t cb, void *arg)
+{
+    wake_cb[SENSOR_HAL_WAKE_IRQ] = cb;
+    wake_arg[SENSOR_HAL_WAKE_IRQ] = arg;
+    return backend->start_irq(gpio);
+}
+
+esp_err_t sensor_hal_start_timer(uint32_t period_us, sensor_hal_wake_cb_t cb, void *arg)
+{
+    wake_cb[SENSOR_HAL_WAKE_TIMER] = cb;
+    wake_arg[SENSOR_HAL_WAKE_TIMER] = arg;
+    return backend->start_timer(period_us);
+}
+
+int64_t sensor_hal_time_us(void)
+{
+    return backend->time_us ? backend->time_us() : esp_timer_get_time();
+}
+
+void sensor_hal_get_stats(sensor_hal_dev_t *dev, sensor_hal_dev_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (dev && backend->get_stats)
+        backend->get_stats(dev, out);
+}
+
+esp_err_t sensor_hal_init(const sensor_hal_bus_config_t *cfg)
+{
+    ESP_LOGI(TAG, "Sensor transport: %s", backend->name);
+    esp_err_t ret = backend->init(cfg);
+    if (ret != ESP_OK)
+        return ret;
+
+#if CONFIG_SENSOR_HAL_RECORD
+    // Not fatal: the sensors work without the recorder
+    if (trace_init() != ESP_OK)
+        ESP_LOGW(TAG, "Failed to allocate trace buffer");
+#endif
+    return ESP_OK;
+}
@@ -0,0 +1,195 @@
+#ifndef SENSOR_HAL_H
+#define SENSOR_HAL_H
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Transport between the sensor manager and the hardware: register-level I2C
+// transactions and the MPU wake events (INT pin and watermark timer). The
+// backend is selected in Kconfig. The optional recorder sits on top of the
+// backend and logs every transaction and wake event with its timestamp, so a
+// field capture can later be fed through the same pipeline by the replayer.
+
+#define SENSOR_HAL_MAX_DEVICES 4
+#define SENSOR_HAL_TX_MAX 8 // write bytes of a queued transaction
+
+typedef enum
+{
+    SENSOR_HAL_PRIO_HIGH = 0, // served on every wake event
+    SENSOR_HAL_PRIO_NORMAL,
+    SENSOR_HAL_PRIO_LOW,
+} sensor_hal_prio_t;
+
+typedef enum
+{
+    SENSOR_HAL_WAKE_IRQ = 0, // MPU INT pin
+    SENSOR_HAL_WAKE_TIMER,   // periodic watermark timer
+    SENSOR_HAL_WAKE_SOURCES,
+} sensor_hal_wake_t;
+
+/**
+ * @brief Wake event handler. Runs in ISR context on hardware, in a task on
+ * the replayer; only FromISR primitives may be used.
+ * @param time_us Event time on the esp_timer (or recorded) time base
+ * @return true if a higher priority task was woken
+ */
+typedef bool (*sensor_hal_wake_cb_t)(int64_t time_us, void *arg);
+
+/**
+ * @brief Completion handler of a queued transaction. Runs in the bus context
+ * of the backend (the I2C scheduler task on hardware, the submitting task
+ * otherwise); must not block.
+ * @param result ESP_OK or the transaction error
+ */
+typedef void (*sensor_hal_done_cb_t)(esp_err_t result, void *arg);
+
+typedef struct
+{
+    int index;
+    uint16_t addr;
+    sensor_hal_prio_t prio;
+    const char *name;
+    void *ctx; // backend handle
+} sensor_hal_dev_t;
+
+typedef struct
+{
+    int port;
+    int sda_io;
+    int scl_io;
+} sensor_hal_bus_config_t;
+
+typedef struct
+{
+    uint32_t transactions;
+    uint32_t errors;
+    uint32_t wait_max_us; // queued behind other bus traffic
+} sensor_hal_dev_stats_t;
+
+// ------------------------- Trace Format -------------------------
+// A trace is one header followed by variable-length records, little endian.
+// I2C records carry tx_len written bytes and then rx_len read bytes.
+#define SENSOR_TRACE_MAGIC 0x43525453u // "STRC"
+#define SENSOR_TRACE_VERSION 1
+
+typedef enum
+{
+    SENSOR_TRACE_I2C = 0,
+    SENSOR_TRACE_WAKE_IRQ,
+    SENSOR_TRACE_WAKE_TIMER,
+} sensor_trace_type_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    int64_t start_us; // esp_timer time of t_us == 0
+} sensor_trace_header_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t t_us;  // start of the transaction or time of the wake event
+    uint8_t type;   // sensor_trace_type_t
+    uint8_t addr;   // 7-bit device address, 0 for wake events
+    int16_t result; // esp_err_t of the transaction
+    uint8_t tx_len;
+    uint16_t rx_len;
+} sensor_trace_rec_t;
+
+// ------------------------- API -------------------------
+
+/**
+ * @brief Bring up the selected backend (and the recorder, if enabled).
+ */
+esp_err_t sensor_hal_init(const sensor_hal_bus_config_t *cfg);
+
+/**
+ * @brief Attach a 7-bit I2C device.
+ * @param prio Bus priority; HIGH is reserved for devices drained on wake events
+ */
+esp_err_t sensor_hal_add_device(uint16_t addr, uint32_t scl_hz, sensor_hal_prio_t prio,
+                                const char *name, sensor_hal_dev_t **out);
+
+/**
+ * @brief Write tx_len bytes, then read rx_len bytes (repeated start).
+ * Either part may be empty. Blocks until the transaction has finished.
+ */
+esp_err_t sensor_hal_transfer(sensor_hal_dev_t *dev, const uint8_t *tx, size_t tx_len,
+                              uint8_t *rx, size_t rx_len);
+
+/**
+ * @brief Queue a transaction without waiting for it. tx is copied (at most
+ * SENSOR_HAL_TX_MAX bytes); rx must stay valid until done has run. At most
+ * one queued transaction per device may be in flight.
+ * @return ESP_ERR_TIMEOUT if the bus queue is full; done is not called then
+ */
+esp_err_t sensor_hal_submit(sensor_hal_dev_t *dev, const uint8_t *tx, size_t tx_len,
+                            uint8_t *rx, size_t rx_len, sensor_hal_done_cb_t done, void *arg);
+
+/**
+ * @brief Route rising edges on an interrupt pin to cb.
+ */
+esp_err_t sensor_hal_attach_irq(int gpio, sensor_hal_wake_cb_t cb, void *arg);
+
+/**
+ * @brief Call cb every period_us.
+ */
+esp_err_t sensor_hal_start_timer(uint32_t period_us, sensor_hal_wake_cb_t cb, void *arg);
+
+/**
+ * @brief Current time on the wake-event time base: esp_timer on hardware,
+ * the recorded time of the latest MPU transaction on the replayer. Use it
+ * wherever "now" is compared against sample or wake timestamps.
+ */
+int64_t sensor_hal_time_us(void);
+
+/**
+ * @brief Bus statistics of one device; zeroed if the backend keeps none.
+ */
+void sensor_hal_get_stats(sensor_hal_dev_t *dev, sensor_hal_dev_stats_t *out);
+
+/**
+ * @brief Write the recorded trace (header and records) to a stream.
+ * @return ESP_ERR_NOT_SUPPORTED if the recorder is disabled
+ */
+esp_err_t sensor_hal_trace_write(FILE *f);
+
+// ------------------------- Backends -------------------------
+typedef struct
+{
+    const char *name;
+    esp_err_t (*init)(const sensor_hal_bus_config_t *cfg);
+    esp_err_t (*add_device)(sensor_hal_dev_t *dev, uint32_t scl_hz);
+    esp_err_t (*transfer)(sensor_hal_dev_t *dev, const uint8_t *tx, size_t tx_len,
+                          uint8_t *rx, size_t rx_len);
+    esp_err_t (*submit)(sensor_hal_dev_t *dev, const uint8_t *tx, size_t tx_len, uint8_t *rx,
+                        size_t rx_len, sensor_hal_done_cb_t done, void *arg); // optional
+    esp_err_t (*start_irq)(int gpio);
+    esp_err_t (*start_timer)(uint32_t period_us);
+    void (*get_stats)(sensor_hal_dev_t *dev, sensor_hal_dev_stats_t *out); // optional
+    int64_t (*time_us)(void); // optional, esp_timer if NULL
+} sensor_hal_backend_t;
+
+/**
+ * @brief Called by the backend for every wake event; records it and runs
+ * the registered handler.
+ * @return true if a higher priority task was woken
+ */
+bool sensor_hal_deliver_wake(sensor_hal_wake_t src, int64_t time_us);
+
+#if CONFIG_SENSOR_HAL_I2C
+extern const sensor_hal_backend_t sensor_hal_i2c_backend;
+#endif
+#if CONFIG_SENSOR_HAL_REPLAY
+extern const sensor_hal_backend_t sensor_hal_replay_backend;
+#endif
+#if CONFIG_SENSOR_HAL_SYNTH
+extern const sensor_hal_backend_t sensor_hal_synth_backend;
+#endif
+
+#endif // SENSOR_HAL_H
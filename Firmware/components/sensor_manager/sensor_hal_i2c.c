@@ -0,0 +1,121 @@
+#include "sensor_hal.h"
+#include "i2c_scheduler.h"
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+// Hardware backend: transactions go through the I2C scheduler, wake events
+// come from the GPIO ISR service and an esp_timer.
+
+static esp_timer_handle_t wake_timer;
+
+static void IRAM_ATTR gpio_wake_isr(void *arg)
+{
+    if (sensor_hal_deliver_wake(SENSOR_HAL_WAKE_IRQ, esp_timer_get_time()))
+        portYIELD_FROM_ISR();
+}
+
+static void IRAM_ATTR timer_wake_cb(void *arg)
+{
+    bool yield = sensor_hal_deliver_wake(SENSOR_HAL_WAKE_TIMER, esp_timer_get_time());
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+    if (yield)
+        esp_timer_isr_dispatch_need_yield();
+#else
+    (void)yield; // task dispatch: the woken task runs when the timer task blocks
+#endif
+}
+
+static esp_err_t i2c_backend_init(const sensor_hal_bus_config_t *cfg)
+{
+    i2c_sched_bus_config_t bus = {
+        .port = cfg->port,
+        .sda_io = cfg->sda_io,
+        .scl_io = cfg->scl_io};
+    return i2c_scheduler_init(&bus);
+}
+
+static esp_err_t i2c_backend_add_device(sensor_hal_dev_t *dev, uint32_t scl_hz)
+{
+    static const i2c_sched_prio_t prio_map[] = {
+        [SENSOR_HAL_PRIO_HIGH] = I2C_SCHED_PRIO_HIGH,
+        [SENSOR_HAL_PRIO_NORMAL] = I2C_SCHED_PRIO_NORMAL,
+        [SENSOR_HAL_PRIO_LOW] = I2C_SCHED_PRIO_LOW};
+    i2c_sched_dev_t handle;
+    esp_err_t ret = i2c_scheduler_add_device(dev->addr, scl_hz, prio_map[dev->prio], dev->name, &handle);
+    if (ret == ESP_OK)
+        dev->ctx = handle;
+    return ret;
+}
+
+static esp_err_t i2c_backend_transfer(sensor_hal_dev_t *dev, const uint8_t *tx, size_t tx_len,
+                                      uint8_t *rx, size_t rx_len)
+{
+    return i2c_scheduler_transfer(dev->ctx, tx, tx_len, rx, rx_len);
+}
+
+static esp_err_t i2c_backend_submit(sensor_hal_dev_t *dev, const uint8_t *tx, size_t tx_len, uint8_t *rx,
+                                    size_t rx_len, sensor_hal_done_cb_t done, void *arg)
+{
+    i2c_sched_txn_t txn = {
+        .tx_len = tx_len,
+        .rx = rx,
+        .rx_len = rx_len,
+        .done = done,
+        .arg = arg};
+    if (tx_len)
+        memcpy(txn.tx, tx, tx_len);
+    return i2c_scheduler_submit(dev->ctx, &txn, 0);
+}
+
+static esp_err_t i2c_backend_start_irq(int gpio)
+{
+    gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_POSEDGE,
+        .mode = GPIO_MODE_INPUT,
+        .pin_bit_mask = (1ULL << gpio),
+        .pull_up_en = 0};
+    gpio_config(&io_conf);
+    gpio_install_isr_service(0);
+    return gpio_isr_handler_add(gpio, gpio_wake_isr, NULL);
+}
+
+static esp_err_t i2c_backend_start_timer(uint32_t period_us)
+{
+    esp_timer_create_args_t timer_args = {
+        .callback = timer_wake_cb,
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+        .dispatch_method = ESP_TIMER_ISR,
+#else
+        .dispatch_method = ESP_TIMER_TASK,
+#endif
+        .name = "mpu_watermark",
+        .skip_unhandled_events = true};
+    esp_err_t ret = esp_timer_create(&timer_args, &wake_timer);
+    if (ret != ESP_OK)
+        return ret;
+    return esp_timer_start_periodic(wake_timer, period_us);
+}
+
+static void i2c_backend_get_stats(sensor_hal_dev_t *dev, sensor_hal_dev_stats_t *out)
+{
+    i2c_sched_dev_stats_t s;
+    if (i2c_scheduler_get_stats(dev->ctx, &s) != ESP_OK)
+        return;
+    out->transactions = s.transactions;
+    out->errors = s.errors;
+    out->wait_max_us = s.wait_max_us;
+}
+
+const sensor_hal_backend_t sensor_hal_i2c_backend = {
+    .name = "i2c",
+    .init = i2c_backend_init,
+    .add_device = i2c_backend_add_device,
+    .transfer = i2c_backend_transfer,
+    .submit = i2c_backend_submit,
+    .start_irq = i2c_backend_start_irq,
+    .start_timer = i2c_backend_start_timer,
+    .get_stats = i2c_backend_get_stats,
+};
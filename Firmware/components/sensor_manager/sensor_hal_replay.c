@@ -0,0 +1,307 @@
+#include "sensor_hal.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Replay backend: serves I2C reads from a recorded trace and re-issues the
+// recorded wake events. Each device consumes its own records in order. A wake
+// event is only delivered once the HIGH priority devices have consumed every
+// record that preceded it in the trace, so the MPU task sees exactly the FIFO
+// contents it saw during the capture, however fast the replay runs. Slow
+// devices keep their own (real-time) pace: each of their transactions gets the
+// latest record with the same written bytes whose recorded time is not after
+// the MPU's, so they see the values of the same moment in the capture however
+// often they poll.
+
+static const char *TAG = "SENSOR_REPLAY";
+
+// ------------------------- Globals -------------------------
+static uint8_t *trace;
+static uint32_t *rec_offset; // byte offset of every record
+static uint32_t num_recs;
+static int64_t trace_start_us;
+static _Atomic int64_t replay_now_us; // recorded start of the latest HIGH transaction
+
+static uint32_t cursor[SENSOR_HAL_MAX_DEVICES]; // HIGH: next record to search from
+// Slow devices: records up to the replay time are indexed by what they wrote
+#define REPLAY_SLOW_KEYS 8
+static uint32_t scanned[SENSOR_HAL_MAX_DEVICES];                  // records indexed so far
+static uint32_t latest[SENSOR_HAL_MAX_DEVICES][REPLAY_SLOW_KEYS]; // record index + 1, 0 = free
+static uint8_t next_key[SENSOR_HAL_MAX_DEVICES];                  // slot to replace when full
+static uint8_t high_addr[128];                  // addresses of HIGH devices
+static atomic_uint high_consumed;
+static atomic_uint mismatches;
+static volatile bool wake_enabled[SENSOR_HAL_WAKE_SOURCES];
+static SemaphoreHandle_t progress;
+static TaskHandle_t replay_task_handle;
+
+static inline const sensor_trace_rec_t *rec_at(uint32_t i)
+{
+    return (const sensor_trace_rec_t *)(trace + rec_offset[i]);
+}
+
+// ------------------------- Replay Task -------------------------
+static void replay_task(void *arg)
+{
+    uint32_t high_needed = 0, delivered = 0, remapped = 0;
+    int64_t wall_start_us = esp_timer_get_time();
+
+    for (uint32_t i = 0; i < num_recs; i++)
+    {
+        const sensor_trace_rec_t *rec = rec_at(i);
+        if (rec->type == SENSOR_TRACE_I2C)
+        {
+            if (high_addr[rec->addr & 0x7F])
+                high_needed++;
+            continue;
+        }
+
+        sensor_hal_wake_t src = rec->type == SENSOR_TRACE_WAKE_IRQ ? SENSOR_HAL_WAKE_IRQ : SENSOR_HAL_WAKE_TIMER;
+        while (atomic_load(&high_consumed) < high_needed)
+            xSemaphoreTake(progress, pdMS_TO_TICKS(10));
+        if (!wake_enabled[src])
+        {
+            // Captured in the other acquisition mode (e.g. a watermark-timer
+            // trace replayed with DATA_RDY): the drain still has to run where
+            // it ran during the capture, so deliver it on the started source
+            sensor_hal_wake_t other = src == SENSOR_HAL_WAKE_IRQ ? SENSOR_HAL_WAKE_TIMER : SENSOR_HAL_WAKE_IRQ;
+            if (remapped++ == 0)
+                ESP_LOGW(TAG, "Trace has %s wake events, which this build does not start; delivering them as %s",
+                         src == SENSOR_HAL_WAKE_IRQ ? "IRQ" : "timer", other == SENSOR_HAL_WAKE_IRQ ? "IRQ" : "timer");
+            src = other;
+        }
+
+#if CONFIG_SENSOR_HAL_REPLAY_SPEED > 0
+        int64_t due_us = wall_start_us + rec->t_us / CONFIG_SENSOR_HAL_REPLAY_SPEED;
+        int64_t ahead_us = due_us - esp_timer_get_time();
+        if (ahead_us >= 1000 * portTICK_PERIOD_MS)
+            vTaskDelay(ahead_us / (1000 * portTICK_PERIOD_MS));
+#endif
+
+        if (sensor_hal_deliver_wake(src, trace_start_us + rec->t_us))
+            taskYIELD();
+        delivered++;
+    }
+
+    ESP_LOGI(TAG, "Replay finished: %lu wake events (%lu remapped) in %lld ms, %u mismatched transactions",
+             (unsigned long)delivered, (unsigned long)remapped, (esp_timer_get_time() - wall_start_us) / 1000,
+             atomic_load(&mismatches));
+    replay_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+static esp_err_t replay_start(sensor_hal_wake_t src)
+{
+    wake_enabled[src] = true;
+    xSemaphoreGive(progress);
+    if (replay_task_handle)
+        return ESP_OK;
+    if (xTaskCreate(replay_task, "sensor_replay", 3072, NULL, 13, &replay_task_handle) != pdPASS)
+        return ESP_ERR_NO_MEM;
+    return ESP_OK;
+}
+
+// ------------------------- Backend -------------------------
+static esp_err_t replay_init(const sensor_hal_bus_config_t *cfg)
+{
+    FILE *f = fopen(CONFIG_SENSOR_HAL_REPLAY_PATH, "rb");
+    if (!f)
+    {
+        ESP_LOGE(TAG, "Cannot open trace %s", CONFIG_SENSOR_HAL_REPLAY_PATH);
+        return ESP_ERR_NOT_FOUND;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    sensor_trace_header_t hdr;
+    if (size < (long)sizeof(hdr) || fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+        hdr.magic != SENSOR_TRACE_MAGIC || hdr.version != SENSOR_TRACE_VERSION)
+    {
+        ESP_LOGE(TAG, "%s is not a sensor trace", CONFIG_SENSOR_HAL_REPLAY_PATH);
+        fclose(f);
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    size_t len = size - sizeof(hdr);
+    trace = heap_caps_malloc(len, MALLOC_CAP_SPIRAM);
+    if (!trace)
+        trace = malloc(len);
+    if (!trace || fread(trace, 1, len, f) != len)
+    {
+        fclose(f);
+        return trace ? ESP_FAIL : ESP_ERR_NO_MEM;
+    }
+    fclose(f);
+    trace_start_us = hdr.start_us;
+
+    // Index the records; a truncated last record is ignored
+    for (int pass = 0; pass < 2; pass++)
+    {
+        uint32_t n = 0;
+        for (size_t off = 0; off + sizeof(sensor_trace_rec_t) <= len;)
+        {
+            const sensor_trace_rec_t *rec = (const sensor_trace_rec_t *)(trace + off);
+            size_t rec_len = sizeof(*rec) + rec->tx_len + rec->rx_len;
+            if (off + rec_len > len)
+                break;
+            if (pass)
+                rec_offset[n] = off;
+            n++;
+            off += rec_len;
+        }
+        if (!pass)
+        {
+            num_recs = n;
+            rec_offset = malloc((n ? n : 1) * sizeof(uint32_t));
+            if (!rec_offset)
+                return ESP_ERR_NO_MEM;
+        }
+    }
+
+    progress = xSemaphoreCreateBinary();
+    if (!progress)
+        return ESP_ERR_NO_MEM;
+
+    ESP_LOGI(TAG, "Loaded %lu records (%u bytes) from %s", (unsigned long)num_recs, (unsigned)len,
+             CONFIG_SENSOR_HAL_REPLAY_PATH);
+    return ESP_OK;
+}
+
+static esp_err_t replay_add_device(sensor_hal_dev_t *dev, uint32_t scl_hz)
+{
+    cursor[dev->index] = 0;
+    scanned[dev->index] = 0;
+    memset(latest[dev->index], 0, sizeof(latest[dev->index]));
+    if (dev->prio == SENSOR_HAL_PRIO_HIGH)
+        high_addr[dev->addr & 0x7F] = 1;
+    return ESP_OK;
+}
+
+static bool rec_is_dev(const sensor_trace_rec_t *rec, const sensor_hal_dev_t *dev)
+{
+    return rec->type == SENSOR_TRACE_I2C && rec->addr == dev->addr;
+}
+
+// Same transaction: written bytes and read length
+static bool rec_same_txn(const sensor_trace_rec_t *rec, const uint8_t *tx, size_t tx_len, size_t rx_len)
+{
+    return rec->tx_len == tx_len && rec->rx_len == rx_len && memcmp(rec + 1, tx, tx_len) == 0;
+}
+
+static bool rec_same_as(const sensor_trace_rec_t *rec, const sensor_trace_rec_t *other)
+{
+    return rec_same_txn(rec, (const uint8_t *)(other + 1), other->tx_len, other->rx_len);
+}
+
+// Next record of a HIGH device, in trace order
+static uint32_t replay_next_high(sensor_hal_dev_t *dev)
+{
+    uint32_t i = cursor[dev->index];
+    while (i < num_recs && !rec_is_dev(rec_at(i), dev))
+        i++;
+    cursor[dev->index] = i < num_recs ? i + 1 : i;
+    return i;
+}
+
+// Latest record of a slow device for this transaction at the replay time.
+// Before the first one is due, the next one in the trace.
+static uint32_t replay_find_slow(sensor_hal_dev_t *dev, const uint8_t *tx, size_t tx_len, size_t rx_len)
+{
+    uint32_t *slots = latest[dev->index];
+    int64_t now = atomic_load(&replay_now_us) - trace_start_us;
+    uint32_t i = scanned[dev->index];
+    for (; i < num_recs && rec_at(i)->t_us <= now; i++)
+    {
+        const sensor_trace_rec_t *rec = rec_at(i);
+        if (!rec_is_dev(rec, dev))
+            continue;
+        int k = 0;
+        while (k < REPLAY_SLOW_KEYS && slots[k] && !rec_same_as(rec, rec_at(slots[k] - 1)))
+            k++;
+        if (k == REPLAY_SLOW_KEYS)
+        {
+            k = next_key[dev->index];
+            next_key[dev->index] = (k + 1) % REPLAY_SLOW_KEYS;
+        }
+        slots[k] = i + 1;
+    }
+    scanned[dev->index] = i;
+
+    for (int k = 0; k < REPLAY_SLOW_KEYS && slots[k]; k++)
+        if (rec_same_txn(rec_at(slots[k] - 1), tx, tx_len, rx_len))
+            return slots[k] - 1;
+    for (; i < num_recs; i++)
+        if (rec_is_dev(rec_at(i), dev) && rec_same_txn(rec_at(i), tx, tx_len, rx_len))
+            return i;
+    return num_recs;
+}
+
+static esp_err_t replay_transfer(sensor_hal_dev_t *dev, const uint8_t *tx, size_t tx_len,
+                                 uint8_t *rx, size_t rx_len)
+{
+    uint32_t i = dev->prio == SENSOR_HAL_PRIO_HIGH ? replay_next_high(dev) : replay_find_slow(dev, tx, tx_len, rx_len);
+    if (i == num_recs)
+    {
+        // End of trace, or a slow transaction the capture never made
+        if (dev->prio != SENSOR_HAL_PRIO_HIGH)
+            atomic_fetch_add(&mismatches, 1);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const sensor_trace_rec_t *rec = rec_at(i);
+    const uint8_t *rec_tx = (const uint8_t *)(rec + 1);
+    const uint8_t *rec_rx = rec_tx + rec->tx_len;
+    if (!rec_same_txn(rec, tx, tx_len, rx_len))
+    {
+        // The firmware took a different path than during the capture
+        if (atomic_fetch_add(&mismatches, 1) == 0)
+            ESP_LOGW(TAG, "%s: transaction %lu differs from the trace", dev->name, (unsigned long)i);
+    }
+    if (rx_len)
+    {
+        size_t n = rec->rx_len < rx_len ? rec->rx_len : rx_len;
+        memcpy(rx, rec_rx, n);
+        memset(rx + n, 0, rx_len - n);
+    }
+
+    if (dev->prio == SENSOR_HAL_PRIO_HIGH)
+    {
+        // Set by the MPU task only; slow devices read it from their own tasks
+        atomic_store(&replay_now_us, trace_start_us + rec->t_us);
+        atomic_fetch_add(&high_consumed, 1);
+        xSemaphoreGive(progress);
+    }
+    return rec->result;
+}
+
+static int64_t replay_time_us(void)
+{
+    return atomic_load(&replay_now_us);
+}
+
+static esp_err_t replay_start_irq(int gpio)
+{
+    return replay_start(SENSOR_HAL_WAKE_IRQ);
+}
+
+static esp_err_t replay_start_timer(uint32_t period_us)
+{
+    return replay_start(SENSOR_HAL_WAKE_TIMER);
+}
+
+const sensor_hal_backend_t sensor_hal_replay_backend = {
+    .name = "replay",
+    .init = replay_init,
+    .add_device = replay_add_device,
+    .transfer = replay_transfer,
+    .start_irq = replay_start_irq,
+    .start_timer = replay_start_timer,
+    .time_us = replay_time_us,
+};
@@ -0,0 +1,426 @@
+#include "sensor_hal.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <math.h>
+#include <string.h>
+
+// Synthetic backend: emulates the register interface of the three sensors so
+// the unmodified drivers run on generated data. The MPU6050 FIFO is filled
+// lazily from the elapsed time at CONFIG_SENSOR_SYNTH_RATE_HZ, honouring the
+// FIFO_EN layout, FIFO reset and the 1024-byte capacity (oldest frames are
+// lost on overflow). DATA_RDY interrupts are generated only if the driver
+// enabled them, exactly like the real part.
+
+static const char *TAG = "SENSOR_SYNTH";
+
+// ------------------------- Emulated Registers -------------------------
+#define SYNTH_MPU_ADDR 0x68
+#define SYNTH_MPU_FIFO_EN 0x23
+#define SYNTH_MPU_INT_ENABLE 0x38
+#define SYNTH_MPU_INT_STATUS 0x3A
+#define SYNTH_MPU_USER_CTRL 0x6A
+#define SYNTH_MPU_FIFO_COUNTH 0x72
+#define SYNTH_MPU_FIFO_R_W 0x74
+#define SYNTH_MPU_FIFO_BYTES 1024
+#define SYNTH_MPU_FIFO_RESET 0x04
+#define SYNTH_MPU_INT_DATA_RDY 0x01
+#define SYNTH_MPU_INT_FIFO_OFLOW 0x10
+
+#define SYNTH_INA_ADDR 0x40
+#define SYNTH_INA_SHUNT 0x01
+#define SYNTH_INA_BUS 0x02
+#define SYNTH_INA_POWER 0x03
+#define SYNTH_INA_CURRENT 0x04
+#define SYNTH_INA_CALIB 0x05
+#define SYNTH_INA_MASK_ENABLE 0x06
+#define SYNTH_INA_CVRF 0x0008
+#define SYNTH_INA_SHUNT_OHMS 0.1f // same as the board
+#define SYNTH_INA_BUS_V 12.0f
+
+#define SYNTH_SHTC_ADDR 0x70
+
+#define SYNTH_RATE_HZ CONFIG_SENSOR_SYNTH_RATE_HZ
+#define SYNTH_PERIOD_US (1000000 / SYNTH_RATE_HZ) // DATA_RDY timer only
+
+// ------------------------- Globals -------------------------
+typedef struct
+{
+    uint8_t reg; // register pointer from the last write
+    uint8_t fifo_en;
+    uint8_t int_enable;
+    uint8_t int_status;
+    uint8_t frame_size;
+    uint64_t fifo_head; // next sample index to enter the FIFO
+    uint64_t fifo_tail; // oldest sample index still in the FIFO
+    int64_t start_us;   // time of sample index 0
+    uint32_t rng;
+    uint32_t overflows;
+} synth_mpu_t;
+
+static synth_mpu_t mpu = {.rng = 0x12345678};
+static uint8_t ina_reg;
+static uint16_t ina_calib;
+static uint16_t shtc_cmd;
+static int64_t synth_start_us;
+static esp_timer_handle_t irq_timer, wake_timer;
+
+// ------------------------- Signal Model -------------------------
+static uint32_t xorshift32(uint32_t *s)
+{
+    uint32_t x = *s;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *s = x;
+}
+
+// Roughly Gaussian, unit variance (Irwin-Hall with four uniforms)
+static float noise(uint32_t *s)
+{
+    float sum = 0.0f;
+    for (int i = 0; i < 4; i++)
+        sum += (xorshift32(s) >> 8) * (1.0f / 16777216.0f);
+    return (sum - 2.0f) * 1.7320508f;
+}
+
+// sin(2 pi f k / rate) with the phase reduced in integers, exact for any k
+static float tone(uint32_t freq_hz, uint64_t k)
+{
+    uint32_t phase = (uint32_t)(((uint64_t)freq_hz * k) % SYNTH_RATE_HZ);
+    return sinf(2.0f * (float)M_PI * phase / SYNTH_RATE_HZ);
+}
+
+static int16_t clamp16(float v)
+{
+    if (v > INT16_MAX)
+        return INT16_MAX;
+    if (v < INT16_MIN)
+        return INT16_MIN;
+    return (int16_t)lrintf(v);
+}
+
+static void put16(uint8_t *p, int16_t v)
+{
+    p[0] = (uint16_t)v >> 8;
+    p[1] = (uint16_t)v & 0xFF;
+}
+
+static void synth_frame(uint64_t k, uint8_t *out)
+{
+    const float g = 16384.0f; // +-2 g
+    float ax = CONFIG_SENSOR_SYNTH_TONE1_MG * 1e-3f * tone(CONFIG_SENSOR_SYNTH_TONE1_HZ, k);
+    float ay = CONFIG_SENSOR_SYNTH_TONE2_MG * 1e-3f * tone(CONFIG_SENSOR_SYNTH_TONE2_HZ, k);
+    float az = 1.0f;
+
+    const float n = CONFIG_SENSOR_SYNTH_NOISE_MG * 1e-3f;
+    ax += n * noise(&mpu.rng);
+    ay += n * noise(&mpu.rng);
+    az += n * noise(&mpu.rng);
+
+#if CONFIG_SENSOR_SYNTH_IMPULSE_MS > 0
+    // Decaying, sign-alternating burst: broadband and heavy-tailed
+    const uint64_t interval = (uint64_t)CONFIG_SENSOR_SYNTH_IMPULSE_MS * SYNTH_RATE_HZ / 1000;
+    uint32_t j = (uint32_t)(k % interval);
+    if (j < 16)
+    {
+        float a = CONFIG_SENSOR_SYNTH_IMPULSE_MG * 1e-3f * expf(-(float)j / 4.0f) * ((j & 1) ? -1.0f : 1.0f);
+        ax += a;
+        az += 0.5f * a;
+    }
+#endif
+
+    uint8_t *p = out;
+    if (mpu.fifo_en & 0x08)
+    {
+        put16(p, clamp16(ax * g));
+        put16(p + 2, clamp16(ay * g));
+        put16(p + 4, clamp16(az * g));
+        p += 6;
+    }
+    if (mpu.fifo_en & 0x80)
+    {
+        float die_c = 35.0f + 0.05f * noise(&mpu.rng);
+        put16(p, clamp16((die_c - 36.53f) * 340.0f));
+        p += 2;
+    }
+    if (mpu.fifo_en & 0x70)
+    {
+        // Rotation follows the first tone, as for an out-of-balance rotor
+        const float dps = 131.0f;
+        put16(p, clamp16(5.0f * tone(CONFIG_SENSOR_SYNTH_TONE1_HZ, k) * dps));
+        put16(p + 2, clamp16(0.2f * noise(&mpu.rng) * dps));
+        put16(p + 4, clamp16(0.2f * noise(&mpu.rng) * dps));
+    }
+}
+
+// Bring the FIFO up to date with the elapsed time
+static void mpu_fifo_update(void)
+{
+    uint64_t now_index = (uint64_t)(esp_timer_get_time() - mpu.start_us) * SYNTH_RATE_HZ / 1000000;
+    if (now_index <= mpu.fifo_head)
+        return;
+    if (!mpu.frame_size)
+    {
+        // No channel enabled: samples are not buffered
+        mpu.fifo_head = mpu.fifo_tail = now_index;
+        return;
+    }
+    mpu.fifo_head = now_index;
+    mpu.int_status |= SYNTH_MPU_INT_DATA_RDY;
+
+    uint64_t capacity = SYNTH_MPU_FIFO_BYTES / mpu.frame_size;
+    if (mpu.fifo_head - mpu.fifo_tail > capacity)
+    {
+        mpu.fifo_tail = mpu.fifo_head - capacity;
+        mpu.int_status |= SYNTH_MPU_INT_FIFO_OFLOW;
+        mpu.overflows++;
+    }
+}
+
+static void mpu_write_reg(uint8_t reg, uint8_t val)
+{
+    switch (reg)
+    {
+    case SYNTH_MPU_FIFO_EN:
+        mpu_fifo_update(); // samples so far were taken with the old layout
+        mpu.fifo_en = val;
+        mpu.frame_size = ((val & 0x08) ? 6 : 0) + ((val & 0x80) ? 2 : 0) + ((val & 0x70) ? 6 : 0);
+        break;
+    case SYNTH_MPU_INT_ENABLE:
+        mpu.int_enable = val;
+        break;
+    case SYNTH_MPU_USER_CTRL:
+        if (val & SYNTH_MPU_FIFO_RESET)
+        {
+            mpu_fifo_update();
+            mpu.fifo_tail = mpu.fifo_head;
+        }
+        break;
+    default:
+        break; // configuration the model does not need
+    }
+}
+
+static esp_err_t mpu_transfer(const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len)
+{
+    if (tx_len >= 1)
+        mpu.reg = tx[0];
+    if (tx_len >= 2)
+        mpu_write_reg(tx[0], tx[1]);
+    if (!rx_len)
+        return ESP_OK;
+
+    mpu_fifo_update();
+    memset(rx, 0, rx_len);
+    switch (mpu.reg)
+    {
+    case SYNTH_MPU_INT_STATUS:
+        rx[0] = mpu.int_status;
+        mpu.int_status = 0; // cleared on read
+        break;
+    case SYNTH_MPU_FIFO_COUNTH:
+    {
+        uint32_t bytes = (uint32_t)(mpu.fifo_head - mpu.fifo_tail) * mpu.frame_size;
+        rx[0] = bytes >> 8;
+        if (rx_len > 1)
+            rx[1] = bytes & 0xFF;
+        break;
+    }
+    case SYNTH_MPU_FIFO_R_W:
+        for (size_t off = 0; mpu.frame_size && off + mpu.frame_size <= rx_len &&
+                             mpu.fifo_tail < mpu.fifo_head;
+             off += mpu.frame_size)
+            synth_frame(mpu.fifo_tail++, rx + off);
+        break;
+    default:
+        break;
+    }
+    return ESP_OK;
+}
+
+// Square wave between the two current levels
+static float synth_current_a(void)
+{
+    int64_t ms = (esp_timer_get_time() - synth_start_us) / 1000;
+    bool high = (ms / CONFIG_SENSOR_SYNTH_CURRENT_STEP_MS) & 1;
+    return (high ? CONFIG_SENSOR_SYNTH_CURRENT_HIGH_MA : CONFIG_SENSOR_SYNTH_CURRENT_LOW_MA) * 1e-3f;
+}
+
+static esp_err_t ina_transfer(const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len)
+{
+    if (tx_len >= 1)
+        ina_reg = tx[0];
+    if (tx_len >= 3 && tx[0] == SYNTH_INA_CALIB)
+        ina_calib = (tx[1] << 8) | tx[2];
+    if (!rx_len)
+        return ESP_OK;
+
+    // Same arithmetic as the chip: current = shunt * CAL / 2048
+    float current_a = synth_current_a();
+    int32_t shunt_raw = lrintf(current_a * SYNTH_INA_SHUNT_OHMS / 2.5e-6f);
+    int32_t current_raw = shunt_raw * ina_calib / 2048;
+    uint16_t bus_raw = (uint16_t)lrintf(SYNTH_INA_BUS_V / 1.25e-3f);
+    uint16_t val;
+    switch (ina_reg)
+    {
+    case SYNTH_INA_SHUNT:
+        val = (uint16_t)clamp16(shunt_raw);
+        break;
+    case SYNTH_INA_BUS:
+        val = bus_raw;
+        break;
+    case SYNTH_INA_POWER:
+        val = (uint16_t)((int64_t)current_raw * bus_raw / 20000); // 25 * current_lsb per bit
+        break;
+    case SYNTH_INA_CURRENT:
+        val = (uint16_t)clamp16(current_raw);
+        break;
+    case SYNTH_INA_CALIB:
+        val = ina_calib;
+        break;
+    case SYNTH_INA_MASK_ENABLE:
+        val = SYNTH_INA_CVRF; // a conversion is always ready
+        break;
+    default:
+        val = 0;
+        break;
+    }
+    memset(rx, 0, rx_len);
+    rx[0] = val >> 8;
+    if (rx_len > 1)
+        rx[1] = val & 0xFF;
+    return ESP_OK;
+}
+
+static uint8_t shtc_crc8(const uint8_t *data, int len)
+{
+    uint8_t crc = 0xFF;
+    for (int i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        for (int j = 0; j < 8; j++)
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
+    }
+    return crc;
+}
+
+// Triangle between the configured limits
+static float synth_temperature_c(void)
+{
+    const float lo = CONFIG_SENSOR_SYNTH_TEMP_MIN_C, hi = CONFIG_SENSOR_SYNTH_TEMP_MAX_C;
+    const int64_t ramp_ms = (int64_t)CONFIG_SENSOR_SYNTH_TEMP_RAMP_S * 1000;
+    int64_t ms = ((esp_timer_get_time() - synth_start_us) / 1000) % (2 * ramp_ms);
+    float x = (ms < ramp_ms ? ms : 2 * ramp_ms - ms) / (float)ramp_ms;
+    return lo + (hi - lo) * x;
+}
+
+static esp_err_t shtc_transfer(const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len)
+{
+    if (tx_len >= 2)
+        shtc_cmd = (tx[0] << 8) | tx[1];
+    if (!rx_len)
+        return ESP_OK;
+
+    float t = synth_temperature_c();
+    uint16_t words[2];
+    uint16_t raw_t = (uint16_t)lrintf((t + 45.0f) / 175.0f * 65536.0f);
+    uint16_t raw_h = (uint16_t)lrintf(0.5f * 65536.0f);
+    // Measurement commands 0x7CA2/0x7866/0x609C/0x6458 return T first,
+    // the others RH first
+    bool t_first = shtc_cmd == 0x7CA2 || shtc_cmd == 0x7866 || shtc_cmd == 0x609C || shtc_cmd == 0x6458;
+    words[0] = t_first ? raw_t : raw_h;
+    words[1] = t_first ? raw_h : raw_t;
+
+    uint8_t buf[6];
+    for (int i = 0; i < 2; i++)
+    {
+        buf[3 * i] = words[i] >> 8;
+        buf[3 * i + 1] = words[i] & 0xFF;
+        buf[3 * i + 2] = shtc_crc8(&buf[3 * i], 2);
+    }
+    memset(rx, 0, rx_len);
+    memcpy(rx, buf, rx_len < sizeof(buf) ? rx_len : sizeof(buf));
+    return ESP_OK;
+}
+
+// ------------------------- Wake Sources -------------------------
+static void irq_timer_cb(void *arg)
+{
+    sensor_hal_deliver_wake(SENSOR_HAL_WAKE_IRQ, esp_timer_get_time());
+}
+
+static void wake_timer_cb(void *arg)
+{
+    sensor_hal_deliver_wake(SENSOR_HAL_WAKE_TIMER, esp_timer_get_time());
+}
+
+static esp_err_t start_periodic(esp_timer_handle_t *timer, esp_timer_cb_t cb, const char *name, uint32_t period_us)
+{
+    esp_timer_create_args_t args = {
+        .callback = cb,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = name,
+        .skip_unhandled_events = true};
+    esp_err_t ret = esp_timer_create(&args, timer);
+    if (ret != ESP_OK)
+        return ret;
+    return esp_timer_start_periodic(*timer, period_us);
+}
+
+// ------------------------- Backend -------------------------
+static esp_err_t synth_init(const sensor_hal_bus_config_t *cfg)
+{
+    synth_start_us = esp_timer_get_time();
+    mpu.start_us = synth_start_us;
+    ESP_LOGI(TAG, "Synthetic sensors at %d Hz: tones %d/%d Hz, noise %d mg, impulses every %d ms",
+             SYNTH_RATE_HZ, CONFIG_SENSOR_SYNTH_TONE1_HZ, CONFIG_SENSOR_SYNTH_TONE2_HZ,
+             CONFIG_SENSOR_SYNTH_NOISE_MG, CONFIG_SENSOR_SYNTH_IMPULSE_MS);
+    return ESP_OK;
+}
+
+static esp_err_t synth_add_device(sensor_hal_dev_t *dev, uint32_t scl_hz)
+{
+    if (dev->addr != SYNTH_MPU_ADDR && dev->addr != SYNTH_INA_ADDR && dev->addr != SYNTH_SHTC_ADDR)
+    {
+        ESP_LOGW(TAG, "No model for device 0x%02x", dev->addr);
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t synth_transfer(sensor_hal_dev_t *dev, const uint8_t *tx, size_t tx_len,
+                                uint8_t *rx, size_t rx_len)
+{
+    switch (dev->addr)
+    {
+    case SYNTH_MPU_ADDR:
+        return mpu_transfer(tx, tx_len, rx, rx_len);
+    case SYNTH_INA_ADDR:
+        return ina_transfer(tx, tx_len, rx, rx_len);
+    default:
+        return shtc_transfer(tx, tx_len, rx, rx_len);
+    }
+}
+
+static esp_err_t synth_start_irq(int gpio)
+{
+    // The INT pin only toggles per sample if the driver asked for DATA_RDY
+    if (!(mpu.int_enable & SYNTH_MPU_INT_DATA_RDY))
+        return ESP_OK;
+    return start_periodic(&irq_timer, irq_timer_cb, "synth_drdy", SYNTH_PERIOD_US);
+}
+
+static esp_err_t synth_start_timer(uint32_t period_us)
+{
+    return start_periodic(&wake_timer, wake_timer_cb, "synth_wake", period_us);
+}
+
+const sensor_hal_backend_t sensor_hal_synth_backend = {
+    .name = "synthetic",
+    .init = synth_init,
+    .add_device = synth_add_device,
+    .transfer = synth_transfer,
+    .start_irq = synth_start_irq,
+    .start_timer = synth_start_timer,
+};
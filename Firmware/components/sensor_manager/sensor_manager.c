@@ -1,12 +1,25 @@
 #include "sensor_manager.h"
-#include "driver/i2c_master.h"
-#include "driver/gpio.h"
+#include "sample_ring.h"
+#include "sample_history.h"
+#include "sample_bus.h"
+#include "decimator.h"
+#include "spectrum.h"
+#include "vibration_stats.h"
+#include "attitude.h"
+#include "resampler.h"
+#include "snapshot.h"
+#include "sensor_hal.h"
+#include "energy_meter.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "esp_heap_caps.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/timers.h"
+#include "nvs.h"
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "SENSOR_MANAGER";
@@ -17,8 +30,10 @@ static const char *TAG = "SENSOR_MANAGER";
 #define REG_USER_CTRL 0x6A
 #define REG_FIFO_EN 0x23
 #define REG_INT_ENABLE 0x38
+#define REG_INT_STATUS 0x3A
 #define REG_SMPLRT_DIV 0x19
 #define REG_CONFIG 0x1A
+#define REG_GYRO_CONFIG 0x1B
 #define REG_ACCEL_CONFIG 0x1C
 #define REG_FIFO_COUNTH 0x72
 #define REG_FIFO_COUNTL 0x73
@@ -26,85 +41,344 @@ static const char *TAG = "SENSOR_MANAGER";
 
 #define USER_CTRL_FIFO_RESET 0x04
 #define USER_CTRL_FIFO_EN 0x40
+#define FIFO_EN_TEMP 0x80
+#define FIFO_EN_GYRO 0x70 // XG | YG | ZG
 #define FIFO_EN_ACCEL 0x08
 #define INT_EN_DATA_RDY 0x01
 #define INT_EN_FIFO_OFLOW 0x10
+#define INT_STATUS_FIFO_OFLOW 0x10
+#define MPU_FIFO_SIZE 1024
 
+// The MPU writes enabled channels in register order: accel, temp, gyro
+#if CONFIG_MPU6050_FIFO_ACCEL_TEMP_GYRO
+#define FIFO_EN_MASK (FIFO_EN_ACCEL | FIFO_EN_TEMP | FIFO_EN_GYRO)
+#define FIFO_FRAME_SIZE 14
+#define FIFO_GYRO_OFFSET 8
+#elif CONFIG_MPU6050_FIFO_ACCEL_GYRO
+#define FIFO_EN_MASK (FIFO_EN_ACCEL | FIFO_EN_GYRO)
+#define FIFO_FRAME_SIZE 12
+#define FIFO_GYRO_OFFSET 6
+#else
+#define FIFO_EN_MASK FIFO_EN_ACCEL
 #define FIFO_FRAME_SIZE 6
-#define SAMPLE_RATE_HZ 1000
-#define MPU_INT_PIN GPIO_NUM_21
+#endif
+#define FIFO_TEMP_OFFSET 6
+#if CONFIG_MPU6050_FIFO_BURST_READ
+#define FIFO_BURST_MAX_FRAMES CONFIG_MPU6050_FIFO_BURST_MAX_FRAMES
+#else
+#define FIFO_BURST_MAX_FRAMES 1 // legacy: one transaction per frame
+#endif
+#define FIFO_BURST_MAX_BYTES (FIFO_BURST_MAX_FRAMES * FIFO_FRAME_SIZE)
+#define SAMPLE_RATE_HZ SENSOR_SAMPLE_RATE_HZ
+#define MPU_INT_PIN 21
+
+#if CONFIG_MPU6050_ACQ_WATERMARK
+#define MPU_WAKE_SAMPLES CONFIG_MPU6050_WATERMARK_SAMPLES
+#define MPU_INT_ENABLE INT_EN_FIFO_OFLOW // DATA_RDY is replaced by the watermark timer
+#else
+#define MPU_WAKE_SAMPLES 1
+#define MPU_INT_ENABLE (INT_EN_DATA_RDY | INT_EN_FIFO_OFLOW)
+#endif
+#define MPU_WAKE_PERIOD_US (MPU_WAKE_SAMPLES * (1000000 / SAMPLE_RATE_HZ))
+
+// Sample clock (µs in Q16 fixed point)
+#define SAMPLE_PERIOD_Q16 (((int64_t)1000000 << 16) / SAMPLE_RATE_HZ)
+#define CLOCK_PHASE_GAIN_SHIFT 3  // apply 1/8 of the phase error per wakeup
+#define CLOCK_FREQ_GAIN_SHIFT 8   // and 1/256 of the per-sample error to the period
+#define CLOCK_MAX_DRIFT_SHIFT 5   // period may deviate at most 1/32 (~3%) from nominal
+#define CLOCK_RESYNC_US (20 * 1000000 / SAMPLE_RATE_HZ)
+
+// Calibration: the sensor must lie flat (+1 g on Z) and still
+#define CALIB_NVS_NAMESPACE "sensor"
+#define CALIB_NVS_KEY "mpu_offsets"
+#define CALIB_MAX_SPREAD_LSB 820 // ~50 mg peak-to-peak on any accel axis means it moved
+#define CALIB_GRAVITY_LSB 16384  // 1 g at +-2 g full scale
 
 // ------------------------- INA226 -------------------------
 #define INA226_DEVICE_ADDRESS 0x40
 #define INA226_REG_CONFIG 0x00
+#define INA226_REG_BUS_VOLTAGE 0x02
+#define INA226_REG_POWER 0x03
 #define INA226_REG_CURRENT 0x04
 #define INA226_REG_CALIB 0x05
-#define INA226_DEFAULT_CONFIG 0x4127
+#define INA226_REG_MASK_ENABLE 0x06
+
+#define INA226_CONFIG_BASE 0x4000 // reserved bits read as 100b
+#define INA226_MODE_CONTINUOUS 0x0007 // shunt and bus, continuous
+#define INA226_CNVR 0x0400 // ALERT asserts on conversion ready
+#define INA226_CVRF 0x0008 // conversion ready, cleared by reading MASK_ENABLE
+#define INA226_BUS_LSB_V 1.25e-3f
+#define INA226_POWER_LSB_FACTOR 25
+
+#if CONFIG_ENABLE_INA226
+#define INA226_READY_TIMEOUT_US (2 * INA226_CONVERSION_US + 20000)
+#endif
 
 // ------------------------- SHTC3 -------------------------
 #define SHTC3_ADDR 0x70
 #define SHTC3_CMD_WAKEUP 0x3517
-#define SHTC3_CMD_MEASURE_TF 0x7CA2
+#define SHTC3_CMD_SLEEP 0xB098
+#define SHTC3_WAKEUP_US 240
+#define SHTC3_READ_RETRY_US 1000 // reads are NACKed until the measurement is done
+#define SHTC3_READ_RETRIES 3
+// Temperature first, no clock stretching: the bus stays free while measuring
+#if CONFIG_SHTC3_LOW_POWER
+#define SHTC3_CMD_MEASURE 0x609C
+#define SHTC3_MEASURE_US 800
+#else
+#define SHTC3_CMD_MEASURE 0x7866
+#define SHTC3_MEASURE_US 12100
+#endif
 #define CRC8_POLY 0x31
 #define CRC8_INIT 0xFF
 
 // ------------------------- Globals -------------------------
-static i2c_master_bus_handle_t bus_handle;
-static i2c_master_dev_handle_t mpu_dev, ina_dev, shtc_dev;
+static sensor_hal_dev_t *mpu_dev, *ina_dev, *shtc_dev;
 
-static SemaphoreHandle_t i2c_mutex;
-static SemaphoreHandle_t data_mutex;
 static SemaphoreHandle_t mpu_sem;
 
+static uint8_t *fifo_buf; // internal, DMA-capable; holds one FIFO burst
+static volatile int64_t mpu_irq_time_us; // HAL time of the latest wakeup source
+static volatile sensor_manager_stats_t stats = {0};
+static sensor_health_t health;               // mpu_task only, published through latest_health
+static SNAPSHOT_CELL(sensor_health_t) latest_health;
+static int64_t resync_start_us;              // overflow being recovered from, 0 if none
+
+#if CONFIG_ENABLE_INA226
 static float ina226_current_lsb;
-static volatile ina226_data_t latest_ina = {0};
-static volatile shtc3_data_t latest_shtc = {0};
+static uint32_t ina226_current_lsb_ua;
+static energy_meter_t energy; // ina_task only
+#endif
+// Latest values: one writer each, wait-free readers
+static SNAPSHOT_CELL(ina226_data_t) latest_ina;
+static SNAPSHOT_CELL(shtc3_data_t) latest_shtc;
+static resampler_t slow_channels; // slow values, interpolated onto the sample clock on demand
+static SNAPSHOT_CELL(sensor_vibration_stats_t) latest_vib[2]; // indexed by sensor_vib_window_t
 
 // ------------------------- Queues -------------------------
-#define STREAM_QUEUE_LEN 5 // for MQTT/real-time graph
-#define BATCH_QUEUE_LEN 4   // number of batches buffered
+#define STREAM_RING_LEN 8 // for MQTT/real-time graph, power of two
+#define BATCH_POOL_LEN CONFIG_SENSOR_BATCH_POOL_BUFFERS // batch buffers in PSRAM
+
+static sample_ring_slot_t stream_slots[STREAM_RING_LEN];
+static sample_ring_t stream_ring;
+static SemaphoreHandle_t stream_sem; // wakes a blocked sensor_manager_get_next_sample
+static QueueHandle_t batch_queue;     // filled batches, by pointer
+static QueueHandle_t batch_free_queue; // empty batches, by pointer
+static sample_bus_t sample_bus;        // full-rate samples for any number of subscribers
+
+#if CONFIG_SENSOR_HISTORY_SECONDS > 0
+static sample_history_t history;
+static bool history_ready;
+#endif
 
-static QueueHandle_t stream_queue;
-static QueueHandle_t batch_queue;
+static decimator_t stream_decim;              // mpu_task only
+static vib_stats_t vib_stats;                 // mpu_task only
+static attitude_t attitude;                   // mpu_task only
+static volatile bool attitude_ref_request;
+static SNAPSHOT_CELL(sensor_attitude_t) latest_attitude;
+static volatile int stream_rate_request = 0; // applied by mpu_task, 0 if none
 
-static synchronized_sample_t batch_buf[BATCH_SIZE];
+static synchronized_sample_t *batch_buf; // batch being filled, NULL if none
 static int batch_index = 0;
-static int downsample_counter = 0;
+static volatile bool batch_capture_enabled = false;
+static volatile bool batch_flush_request = false; // applied by mpu_task
 
 // ------------------------- I2C Helpers -------------------------
-static esp_err_t i2c_write(i2c_master_dev_handle_t dev, uint8_t reg, uint8_t val)
+// All bus access goes through the sensor HAL. On hardware that is the I2C
+// scheduler, where MPU transactions are queued ahead of the slow sensors so a
+// pending FIFO drain waits for at most one in-flight INA226/SHTC3 transfer.
+static esp_err_t i2c_write(sensor_hal_dev_t *dev, uint8_t reg, uint8_t val)
+{
+    uint8_t buf[2] = {reg, val};
+    stats.i2c_transactions++;
+    return sensor_hal_transfer(dev, buf, 2, NULL, 0);
+}
+
+static esp_err_t i2c_read(sensor_hal_dev_t *dev, uint8_t reg, uint8_t *data, size_t len)
+{
+    stats.i2c_transactions++;
+    return sensor_hal_transfer(dev, &reg, 1, data, len);
+}
+
+// ------------------------- Sample Clock -------------------------
+// Timestamps are rebuilt from the sample sequence number rather than read at
+// decode time: t(seq) = anchor + (seq - anchor_seq) * period. On every wakeup
+// the newest frame in the FIFO is taken to have been sampled at the interrupt
+// time; the difference to the prediction trims the anchor (phase) and the
+// period (MPU oscillator drift against esp_timer), like a small PLL.
+static uint32_t sample_seq;        // sequence number of the next decoded frame
+static uint32_t clock_anchor_seq;
+static int64_t clock_anchor_q16;
+static int64_t clock_period_q16 = SAMPLE_PERIOD_Q16;
+static bool clock_locked;
+
+static void sample_clock_reset(void)
 {
-    esp_err_t ret = ESP_FAIL;
-    if (xSemaphoreTake(i2c_mutex, pdMS_TO_TICKS(20)))
+    clock_locked = false;
+    clock_period_q16 = SAMPLE_PERIOD_Q16;
+}
+
+static inline uint64_t sample_clock_timestamp(uint32_t seq)
+{
+    return (uint64_t)((clock_anchor_q16 + (int32_t)(seq - clock_anchor_seq) * clock_period_q16) >> 16);
+}
+
+static void sample_clock_correct(int64_t irq_us, uint32_t last_seq)
+{
+    int64_t measured = irq_us << 16;
+    int32_t n = (int32_t)(last_seq - clock_anchor_seq);
+    int64_t predicted = clock_anchor_q16 + n * clock_period_q16;
+    int64_t err = measured - predicted;
+
+    if (!clock_locked || n <= 0 || llabs(err) > ((int64_t)CLOCK_RESYNC_US << 16))
     {
-        uint8_t buf[2] = {reg, val};
-        ret = i2c_master_transmit(dev, buf, 2, -1);
-        xSemaphoreGive(i2c_mutex);
+        clock_anchor_q16 = measured;
+        clock_anchor_seq = last_seq;
+        clock_period_q16 = SAMPLE_PERIOD_Q16;
+        clock_locked = true;
+        return;
     }
+
+    int64_t max_drift = SAMPLE_PERIOD_Q16 >> CLOCK_MAX_DRIFT_SHIFT;
+    clock_period_q16 += (err / n) >> CLOCK_FREQ_GAIN_SHIFT;
+    if (clock_period_q16 > SAMPLE_PERIOD_Q16 + max_drift)
+        clock_period_q16 = SAMPLE_PERIOD_Q16 + max_drift;
+    else if (clock_period_q16 < SAMPLE_PERIOD_Q16 - max_drift)
+        clock_period_q16 = SAMPLE_PERIOD_Q16 - max_drift;
+
+    clock_anchor_q16 = predicted + (err >> CLOCK_PHASE_GAIN_SHIFT);
+    clock_anchor_seq = last_seq;
+}
+
+// ------------------------- MPU Calibration -------------------------
+// Offsets are found by averaging CONFIG_MPU6050_CALIBRATION_SAMPLES frames in
+// the decode loop, stored in NVS and restored on later boots. They are added
+// to the raw counts before scaling, so correction costs no float ops.
+#if CONFIG_MPU6050_CALIBRATE_ON_START
+static mpu6050_offsets_t mpu_offsets;       // mpu_task only
+static mpu6050_offsets_t mpu_offsets_saved; // handed to the NVS writer
+static volatile bool calib_request;
+static bool calib_active;
+static int calib_count;
+static int32_t calib_sum[6];
+static int16_t calib_min[3], calib_max[3];
+
+static esp_err_t mpu_load_offsets(mpu6050_offsets_t *out)
+{
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(CALIB_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (ret != ESP_OK)
+        return ret;
+    size_t len = sizeof(*out);
+    ret = nvs_get_blob(nvs, CALIB_NVS_KEY, out, &len);
+    nvs_close(nvs);
+    if (ret == ESP_OK && len != sizeof(*out))
+        ret = ESP_ERR_INVALID_SIZE;
     return ret;
 }
 
-static esp_err_t i2c_read(i2c_master_dev_handle_t dev, uint8_t reg, uint8_t *data, size_t len)
+// Runs in the timer service task, so mpu_task does not wait for the NVS
+// write. The write still disables the flash cache on both cores, which
+// stalls every task running from flash, mpu_task included, for the length
+// of the erase/program; the MPU FIFO is what absorbs that stall.
+static void mpu_save_offsets(void *arg, uint32_t unused)
 {
-    esp_err_t ret = ESP_FAIL;
-    if (xSemaphoreTake(i2c_mutex, pdMS_TO_TICKS(20)))
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(CALIB_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret == ESP_OK)
     {
-        ret = i2c_master_transmit_receive(dev, &reg, 1, data, len, -1);
-        xSemaphoreGive(i2c_mutex);
+        ret = nvs_set_blob(nvs, CALIB_NVS_KEY, &mpu_offsets_saved, sizeof(mpu_offsets_saved));
+        if (ret == ESP_OK)
+            ret = nvs_commit(nvs);
+        nvs_close(nvs);
     }
-    return ret;
+    if (ret != ESP_OK)
+        ESP_LOGW(TAG, "Failed to save MPU offsets: %s", esp_err_to_name(ret));
+}
+
+static inline int16_t mpu_apply_offset(int16_t raw, int32_t offset)
+{
+    int32_t v = raw + offset;
+    return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : (int16_t)v;
 }
 
+static void mpu_calibration_start(void)
+{
+    memset(calib_sum, 0, sizeof(calib_sum));
+    for (int i = 0; i < 3; i++)
+    {
+        calib_min[i] = INT16_MAX;
+        calib_max[i] = INT16_MIN;
+    }
+    calib_count = 0;
+    calib_active = true;
+    ESP_LOGI(TAG, "Calibrating MPU over %d samples, keep the device flat and still",
+             CONFIG_MPU6050_CALIBRATION_SAMPLES);
+}
+
+// raw: accel x/y/z and, if captured, gyro x/y/z, before any offset
+static void mpu_calibration_push(const int16_t raw[6])
+{
+    for (int i = 0; i < 3; i++)
+    {
+        if (raw[i] < calib_min[i])
+            calib_min[i] = raw[i];
+        if (raw[i] > calib_max[i])
+            calib_max[i] = raw[i];
+    }
+    for (int i = 0; i < 6; i++)
+        calib_sum[i] += raw[i];
+    if (++calib_count < CONFIG_MPU6050_CALIBRATION_SAMPLES)
+        return;
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (calib_max[i] - calib_min[i] > CALIB_MAX_SPREAD_LSB)
+        {
+            ESP_LOGW(TAG, "Device moved during calibration, retrying");
+            mpu_calibration_start();
+            return;
+        }
+    }
+
+    int32_t n = calib_count;
+    mpu_offsets.accel_x = -calib_sum[0] / n;
+    mpu_offsets.accel_y = -calib_sum[1] / n;
+    mpu_offsets.accel_z = CALIB_GRAVITY_LSB - calib_sum[2] / n;
+    mpu_offsets.gyro_x = -calib_sum[3] / n;
+    mpu_offsets.gyro_y = -calib_sum[4] / n;
+    mpu_offsets.gyro_z = -calib_sum[5] / n;
+    calib_active = false;
+    ESP_LOGI(TAG, "MPU offsets: accel %ld %ld %ld, gyro %ld %ld %ld",
+             (long)mpu_offsets.accel_x, (long)mpu_offsets.accel_y, (long)mpu_offsets.accel_z,
+             (long)mpu_offsets.gyro_x, (long)mpu_offsets.gyro_y, (long)mpu_offsets.gyro_z);
+
+    mpu_offsets_saved = mpu_offsets;
+    xTimerPendFunctionCall(mpu_save_offsets, NULL, 0, 0);
+}
+
+static void mpu_calibration_init(void)
+{
+    if (mpu_load_offsets(&mpu_offsets) == ESP_OK)
+    {
+        ESP_LOGI(TAG, "Loaded MPU offsets from NVS");
+        return;
+    }
+    calib_request = true; // first boot: calibrate on the first frames
+}
+#endif
+
 // ------------------------- MPU Functions -------------------------
+// FIFO_RESET only acts while the FIFO is disabled and clears itself within
+// the same register write, so back-to-back writes are enough; no settling
+// delay is needed.
 static void mpu_reset_fifo(void)
 {
-    ESP_LOGW(TAG, "Resetting FIFO");
     i2c_write(mpu_dev, REG_USER_CTRL, 0x00);
-    vTaskDelay(pdMS_TO_TICKS(10));
     i2c_write(mpu_dev, REG_USER_CTRL, USER_CTRL_FIFO_RESET);
-    vTaskDelay(pdMS_TO_TICKS(10));
     i2c_write(mpu_dev, REG_USER_CTRL, USER_CTRL_FIFO_EN);
-    i2c_write(mpu_dev, REG_FIFO_EN, FIFO_EN_ACCEL);
+    i2c_write(mpu_dev, REG_FIFO_EN, FIFO_EN_MASK);
+    sample_clock_reset(); // FIFO contents are gone, re-anchor on the next wakeup
 }
 
 static void mpu_init(void)
@@ -115,116 +389,493 @@ static void mpu_init(void)
     i2c_write(mpu_dev, REG_SMPLRT_DIV, 0x00);
     i2c_write(mpu_dev, REG_CONFIG, 0x03);
     i2c_write(mpu_dev, REG_ACCEL_CONFIG, 0x00);
+    i2c_write(mpu_dev, REG_GYRO_CONFIG, 0x00);
     mpu_reset_fifo();
-    i2c_write(mpu_dev, REG_INT_ENABLE, INT_EN_DATA_RDY | INT_EN_FIFO_OFLOW);
+    i2c_write(mpu_dev, REG_INT_ENABLE, MPU_INT_ENABLE);
+#if CONFIG_MPU6050_CALIBRATE_ON_START
+    mpu_calibration_init();
+#endif
 }
 
-// ISR
-static void IRAM_ATTR mpu_isr(void *arg)
+// Wake handler for the INT pin and the watermark timer (ISR context)
+static bool IRAM_ATTR mpu_wake(int64_t time_us, void *arg)
 {
     BaseType_t hp = pdFALSE;
+    mpu_irq_time_us = time_us;
+    stats.isr_entries++;
     xSemaphoreGiveFromISR(mpu_sem, &hp);
-    if (hp)
-        portYIELD_FROM_ISR();
+    return hp == pdTRUE;
 }
 
 // ------------------------- MPU Task -------------------------
+// Append a sample to the batch being filled; full batches are handed to the
+// consumer by pointer and come back through sensor_manager_release_batch().
+static void mpu_fill_batch(const synchronized_sample_t *pkt)
+{
+    if (!batch_buf)
+    {
+        if (xQueueReceive(batch_free_queue, &batch_buf, 0) != pdTRUE)
+        {
+            // Every buffer is still held by the consumer
+            batch_buf = NULL;
+            stats.batch_samples_dropped++;
+            return;
+        }
+        batch_index = 0;
+    }
+
+    batch_buf[batch_index++] = *pkt;
+    if (batch_index == BATCH_SIZE)
+    {
+        // Cannot fail: the queue holds as many entries as the pool
+        xQueueSend(batch_queue, &batch_buf, 0);
+        stats.batches_completed++;
+        batch_buf = NULL;
+    }
+}
+
+// Return the partial batch and every completed one nobody has taken yet to
+// the pool, so the next capture starts with fresh, consecutive samples
+static void mpu_flush_batches(void)
+{
+    synchronized_sample_t *buf;
+    if (batch_buf)
+    {
+        xQueueSend(batch_free_queue, &batch_buf, 0);
+        batch_buf = NULL;
+    }
+    while (xQueueReceive(batch_queue, &buf, 0) == pdTRUE)
+        xQueueSend(batch_free_queue, &buf, 0);
+}
+
+static void mpu_handle_frame(const uint8_t *frame)
+{
+    int16_t ax = (int16_t)((frame[0] << 8) | frame[1]);
+    int16_t ay = (int16_t)((frame[2] << 8) | frame[3]);
+    int16_t az = (int16_t)((frame[4] << 8) | frame[5]);
+#if CONFIG_MPU6050_FIFO_GYRO
+    const uint8_t *g = frame + FIFO_GYRO_OFFSET;
+    int16_t gx = (int16_t)((g[0] << 8) | g[1]);
+    int16_t gy = (int16_t)((g[2] << 8) | g[3]);
+    int16_t gz = (int16_t)((g[4] << 8) | g[5]);
+#endif
+#if CONFIG_MPU6050_CALIBRATE_ON_START
+    if (calib_request)
+    {
+        calib_request = false;
+        mpu_calibration_start();
+    }
+    if (calib_active)
+    {
+#if CONFIG_MPU6050_FIFO_GYRO
+        const int16_t raw[6] = {ax, ay, az, gx, gy, gz};
+#else
+        const int16_t raw[6] = {ax, ay, az, 0, 0, 0};
+#endif
+        mpu_calibration_push(raw);
+    }
+    ax = mpu_apply_offset(ax, mpu_offsets.accel_x);
+    ay = mpu_apply_offset(ay, mpu_offsets.accel_y);
+    az = mpu_apply_offset(az, mpu_offsets.accel_z);
+#if CONFIG_MPU6050_FIFO_GYRO
+    gx = mpu_apply_offset(gx, mpu_offsets.gyro_x);
+    gy = mpu_apply_offset(gy, mpu_offsets.gyro_y);
+    gz = mpu_apply_offset(gz, mpu_offsets.gyro_z);
+#endif
+#endif
+
+    synchronized_sample_t pkt;
+    pkt.seq = sample_seq;
+    pkt.timestamp_us = sample_clock_timestamp(sample_seq);
+    sample_seq++;
+    pkt.accel_x_g = ax / MPU_ACCEL_LSB_PER_G;
+    pkt.accel_y_g = ay / MPU_ACCEL_LSB_PER_G;
+    pkt.accel_z_g = az / MPU_ACCEL_LSB_PER_G;
+    pkt.magnitude = sqrtf(pkt.accel_x_g * pkt.accel_x_g +
+                          pkt.accel_y_g * pkt.accel_y_g +
+                          pkt.accel_z_g * pkt.accel_z_g);
+#if CONFIG_MPU6050_FIFO_TEMP
+    int16_t raw_temp = (int16_t)((frame[FIFO_TEMP_OFFSET] << 8) | frame[FIFO_TEMP_OFFSET + 1]);
+    pkt.die_temperature_c = raw_temp / 340.0f + 36.53f;
+#endif
+#if CONFIG_MPU6050_FIFO_GYRO
+    pkt.gyro_x_dps = gx / MPU_GYRO_LSB_PER_DPS;
+    pkt.gyro_y_dps = gy / MPU_GYRO_LSB_PER_DPS;
+    pkt.gyro_z_dps = gz / MPU_GYRO_LSB_PER_DPS;
+    float chan[DECIM_AXES] = {pkt.accel_x_g, pkt.accel_y_g, pkt.accel_z_g,
+                              pkt.gyro_x_dps, pkt.gyro_y_dps, pkt.gyro_z_dps};
+#else
+    float chan[DECIM_AXES] = {pkt.accel_x_g, pkt.accel_y_g, pkt.accel_z_g};
+#endif
+
+    // Filled in by the consumer (resampler_fill), not per sample
+    pkt.latest_current_a = NAN;
+    pkt.latest_temperature_c = NAN;
+
+#if CONFIG_SENSOR_HISTORY_SECONDS > 0
+    if (history_ready)
+        sample_history_append(&history, pkt.seq, ax, ay, az, pkt.timestamp_us);
+#endif
+
+#if CONFIG_SENSOR_FFT_ENABLE
+    spectrum_push(pkt.magnitude, pkt.timestamp_us);
+#endif
+
+    const int16_t accel_raw[3] = {ax, ay, az};
+#if CONFIG_MPU6050_FIFO_GYRO
+    const int16_t gyro_raw[3] = {gx, gy, gz};
+    const int16_t *gyro_in = gyro_raw;
+#else
+    const int16_t *gyro_in = NULL;
+#endif
+    if (attitude_ref_request)
+    {
+        attitude_ref_request = false;
+        attitude_set_reference(&attitude);
+    }
+    sensor_attitude_t att;
+    if (attitude_update(&attitude, accel_raw, gyro_in, &att))
+    {
+        att.timestamp_us = pkt.timestamp_us;
+        SNAPSHOT_WRITE(&latest_attitude, &att);
+    }
+
+    sensor_vibration_stats_t sliding, tumbling;
+    int ready = vib_stats_push(&vib_stats, chan, pkt.timestamp_us, &sliding, &tumbling);
+    if (ready)
+        SNAPSHOT_WRITE(&latest_vib[SENSOR_VIB_WINDOW_SLIDING], &sliding);
+    if (ready & VIB_STATS_TUMBLING_READY)
+        SNAPSHOT_WRITE(&latest_vib[SENSOR_VIB_WINDOW_TUMBLING], &tumbling);
+
+    // Band-limit and decimate into the real-time ring (overwrites the oldest
+    // sample when full)
+    if (stream_rate_request)
+    {
+        decimator_init(&stream_decim, SAMPLE_RATE_HZ, stream_rate_request);
+        stream_rate_request = 0;
+    }
+    float filtered[DECIM_AXES];
+    if (decimator_push(&stream_decim, chan, filtered))
+    {
+        // Stamp the output with the input sample at the filter's centre tap
+        synchronized_sample_t out = pkt;
+        out.seq = pkt.seq - stream_decim.delay_samples;
+        out.timestamp_us = sample_clock_timestamp(out.seq);
+        out.accel_x_g = filtered[0];
+        out.accel_y_g = filtered[1];
+        out.accel_z_g = filtered[2];
+#if CONFIG_MPU6050_FIFO_GYRO
+        out.gyro_x_dps = filtered[3];
+        out.gyro_y_dps = filtered[4];
+        out.gyro_z_dps = filtered[5];
+#endif
+        out.magnitude = sqrtf(out.accel_x_g * out.accel_x_g +
+                              out.accel_y_g * out.accel_y_g +
+                              out.accel_z_g * out.accel_z_g);
+        sample_ring_push(&stream_ring, &out);
+        xSemaphoreGive(stream_sem);
+    }
+
+    sample_bus_publish(&sample_bus, &pkt);
+
+    if (batch_flush_request)
+    {
+        batch_flush_request = false;
+        mpu_flush_batches();
+    }
+    if (batch_capture_enabled)
+        mpu_fill_batch(&pkt);
+}
+
+// ------------------------- FIFO Overflow -------------------------
+// A full FIFO drops its oldest bytes, and 1024 is not a multiple of the frame
+// size, so after an overflow the frame boundaries are unknown. INT_STATUS is
+// only read when the count says the FIFO is (nearly) full or misaligned, so
+// the normal path costs no extra transaction.
+static bool mpu_fifo_suspect(uint16_t fifo_count)
+{
+    return fifo_count > MPU_FIFO_SIZE - FIFO_FRAME_SIZE || fifo_count % FIFO_FRAME_SIZE != 0;
+}
+
+static void mpu_recover_overflow(uint16_t fifo_count)
+{
+    int64_t now = sensor_hal_time_us(); // same time base as the sample clock
+
+    // Everything since the last decoded frame is lost; skip the sequence
+    // numbers so consumers see the gap
+    uint32_t lost = fifo_count / FIFO_FRAME_SIZE;
+    if (clock_locked)
+    {
+        int64_t gap_us = now - (int64_t)sample_clock_timestamp(sample_seq - 1);
+        if (gap_us > 0 && ((gap_us << 16) / SAMPLE_PERIOD_Q16) > lost)
+            lost = (uint32_t)((gap_us << 16) / SAMPLE_PERIOD_Q16);
+    }
+    sample_seq += lost;
+
+    mpu_reset_fifo();
+    resync_start_us = now;
+
+    health.fifo_overflows++;
+    health.fifo_lost_frames += lost;
+    health.last_overflow_us = now;
+    SNAPSHOT_WRITE(&latest_health, &health);
+    ESP_LOGW(TAG, "FIFO overflow, %lu frames lost", (unsigned long)lost);
+}
+
+// First good drain after a reset: the pipeline is back in step
+static void mpu_resync_done(void)
+{
+    uint32_t us = (uint32_t)(sensor_hal_time_us() - resync_start_us);
+    resync_start_us = 0;
+    health.resync_last_us = us;
+    if (us > health.resync_max_us)
+        health.resync_max_us = us;
+    SNAPSHOT_WRITE(&latest_health, &health);
+}
+
+#if CONFIG_SENSOR_HISTORY_SECONDS > 0
+// Log slow measurements that arrived since the last drain; they apply from
+// the next decoded sample on
+static void mpu_log_slow_channels(void)
+{
+    static uint32_t logged[SENSOR_SLOW_CHANNELS];
+
+    if (!history_ready)
+        return;
+    for (int c = 0; c < SENSOR_SLOW_CHANNELS; c++)
+    {
+        uint32_t count = resampler_count(&slow_channels, (sensor_slow_channel_t)c);
+        resampler_point_t p;
+        if (count != logged[c] && resampler_latest(&slow_channels, (sensor_slow_channel_t)c, &p))
+        {
+            sample_history_update_slow(&history, sample_seq, (sensor_slow_channel_t)c, p.value);
+            logged[c] = count;
+        }
+    }
+}
+#endif
+
+// Drain everything currently in the FIFO, FIFO_BURST_MAX_FRAMES frames per
+// I2C transaction, then decode each burst in a tight loop.
+static void mpu_drain_fifo(void)
+{
+    uint8_t cnt_buf[2];
+    if (i2c_read(mpu_dev, REG_FIFO_COUNTH, cnt_buf, 2) != ESP_OK)
+        return;
+
+    uint16_t fifo_count = (cnt_buf[0] << 8) | cnt_buf[1];
+    if (mpu_fifo_suspect(fifo_count))
+    {
+        uint8_t int_status = 0;
+        i2c_read(mpu_dev, REG_INT_STATUS, &int_status, 1);
+        if ((int_status & INT_STATUS_FIFO_OFLOW) || fifo_count % FIFO_FRAME_SIZE != 0)
+        {
+            mpu_recover_overflow(fifo_count);
+            return;
+        }
+    }
+
+    uint16_t frames = fifo_count / FIFO_FRAME_SIZE;
+    if (frames == 0)
+        return;
+    if (resync_start_us)
+        mpu_resync_done();
+
+    // The newest frame in the FIFO belongs to the latest interrupt
+    sample_clock_correct(mpu_irq_time_us, sample_seq + frames - 1);
+#if CONFIG_SENSOR_HISTORY_SECONDS > 0
+    mpu_log_slow_channels();
+#endif
+
+    while (frames > 0)
+    {
+        uint16_t n = frames > FIFO_BURST_MAX_FRAMES ? FIFO_BURST_MAX_FRAMES : frames;
+        size_t len = n * FIFO_FRAME_SIZE;
+        if (i2c_read(mpu_dev, REG_FIFO_R_W, fifo_buf, len) != ESP_OK)
+            break;
+        frames -= n;
+
+        stats.fifo_bursts++;
+        stats.fifo_frames += n;
+        stats.fifo_bytes += len;
+
+        for (const uint8_t *f = fifo_buf; f < fifo_buf + len; f += FIFO_FRAME_SIZE)
+            mpu_handle_frame(f);
+    }
+    sample_bus_notify(&sample_bus);
+}
+
+// Refresh the per-second wakeup rates once a second
+static void mpu_update_rates(void)
+{
+    static int64_t window_start_us;
+    static uint32_t isr_at_start, wakeups_at_start;
+
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - window_start_us;
+    if (elapsed < 1000000)
+        return;
+
+    uint32_t isr = stats.isr_entries;
+    stats.isr_per_sec = (uint32_t)(((uint64_t)(isr - isr_at_start) * 1000000) / elapsed);
+    stats.mpu_wakeups_per_sec = (uint32_t)(((uint64_t)(stats.mpu_wakeups - wakeups_at_start) * 1000000) / elapsed);
+
+    window_start_us = now;
+    isr_at_start = isr;
+    wakeups_at_start = stats.mpu_wakeups;
+}
+
 static void mpu_task(void *arg)
 {
-    uint8_t buf[FIFO_FRAME_SIZE];
     for (;;)
     {
         if (xSemaphoreTake(mpu_sem, portMAX_DELAY))
         {
-            uint8_t cnt_buf[2];
-            uint16_t fifo_count = 0;
-            if (i2c_read(mpu_dev, REG_FIFO_COUNTH, cnt_buf, 2) == ESP_OK)
-                fifo_count = (cnt_buf[0] << 8) | cnt_buf[1];
-
-            while (fifo_count >= FIFO_FRAME_SIZE)
-            {
-                if (i2c_read(mpu_dev, REG_FIFO_R_W, buf, FIFO_FRAME_SIZE) != ESP_OK)
-                    break;
-                fifo_count -= FIFO_FRAME_SIZE;
-
-                int16_t ax = (int16_t)((buf[0] << 8) | buf[1]);
-                int16_t ay = (int16_t)((buf[2] << 8) | buf[3]);
-                int16_t az = (int16_t)((buf[4] << 8) | buf[5]);
-
-                synchronized_sample_t pkt;
-                pkt.timestamp_us = esp_timer_get_time();
-                pkt.accel_x_g = ax / 16384.0f;
-                pkt.accel_y_g = ay / 16384.0f;
-                pkt.accel_z_g = az / 16384.0f;
-                pkt.magnitude = sqrtf(pkt.accel_x_g * pkt.accel_x_g +
-                                      pkt.accel_y_g * pkt.accel_y_g +
-                                      pkt.accel_z_g * pkt.accel_z_g);
-
-                if (xSemaphoreTake(data_mutex, pdMS_TO_TICKS(10)))
-                {
-                    pkt.latest_current_a = latest_ina.current_a;
-                    pkt.latest_temperature_c = latest_shtc.temperature_c;
-                    xSemaphoreGive(data_mutex);
-                }
-
-                // Push to real-time queue
-                if (++downsample_counter >= 200)
-                { // 1000/100 = 10 Hz
-                    downsample_counter = 0;
-
-                    if (xQueueSend(stream_queue, &pkt, 0) != pdPASS)
-                    {
-                        ESP_LOGI(TAG, "Stream queue full, replaceing with oldest");
-                        // Queue full → drop oldest
-                        synchronized_sample_t dummy;
-                        xQueueReceive(stream_queue, &dummy, 0); // remove one
-                        xQueueSend(stream_queue, &pkt, 0);      // now push latest
-                    }
-                }
-
-                // // Fill batch
-                // batch_buf[batch_index++] = pkt;
-                // if (batch_index == BATCH_SIZE)
-                // {
-                //     if (xQueueSend(batch_queue, batch_buf, 0) != pdPASS)
-                //     {
-                //         ESP_LOGW(TAG, "Batch queue full, dropping batch");
-                //     }
-                //     batch_index = 0;
-                // }
-            }
+            stats.mpu_wakeups++;
+            mpu_drain_fifo();
+            mpu_update_rates();
         }
     }
 }
 
 // ------------------------- INA226 -------------------------
-static esp_err_t read_ina226(ina226_data_t *out)
+#if CONFIG_ENABLE_INA226
+// The INA226 runs continuously with hardware averaging. ALERT is set up as a
+// conversion-ready output, but it is not routed to the ESP32 on this board,
+// so the task sleeps for most of a conversion period and then polls the
+// matching CVRF flag. Each result is read exactly once: the three data
+// registers are read back to back right after the flag, while they all hold
+// the same conversion (the pointer does not auto-increment).
+static uint8_t ina226_config_code(const uint16_t *table, uint16_t value)
+{
+    for (uint8_t i = 0; i < 8; i++)
+        if (table[i] == value)
+            return i;
+    return 0;
+}
+
+static void ina226_write_reg(uint8_t reg, uint16_t val)
+{
+    uint8_t buf[3] = {reg, (val >> 8) & 0xFF, val & 0xFF};
+    stats.i2c_transactions++;
+    sensor_hal_transfer(ina_dev, buf, 3, NULL, 0);
+}
+
+static esp_err_t ina226_read_reg(uint8_t reg, uint16_t *val)
+{
+    uint8_t buf[2];
+    esp_err_t ret = i2c_read(ina_dev, reg, buf, 2);
+    if (ret == ESP_OK)
+        *val = (buf[0] << 8) | buf[1];
+    return ret;
+}
+
+static void ina226_init(void)
+{
+    static const uint16_t avg_table[8] = {1, 4, 16, 64, 128, 256, 512, 1024};
+    static const uint16_t conv_table[8] = {140, 204, 332, 588, 1100, 2116, 4156, 8244};
+    uint8_t avg = ina226_config_code(avg_table, CONFIG_INA226_AVG_SAMPLES);
+    uint8_t ct = ina226_config_code(conv_table, CONFIG_INA226_CONV_TIME_US);
+
+    // A whole-µA current LSB makes the power LSB (25x) a whole number of µW,
+    // which keeps the energy integration in integers
+    uint64_t max_current_ua = (uint64_t)CONFIG_INA226_MAX_CURRENT_MILLIAMPS * 1000;
+    uint64_t shunt_uohm = (uint64_t)CONFIG_INA226_SHUNT_RESISTANCE_MILLIOHMS * 1000;
+    ina226_current_lsb_ua = (uint32_t)((max_current_ua + 32767) / 32768);
+    // CAL is a 15-bit register: a small shunt needs a coarser LSB to fit
+    uint32_t min_lsb_ua = (uint32_t)((5120000000ULL + 32767 * shunt_uohm - 1) / (32767 * shunt_uohm));
+    if (ina226_current_lsb_ua < min_lsb_ua)
+        ina226_current_lsb_ua = min_lsb_ua;
+    ina226_current_lsb = ina226_current_lsb_ua * 1e-6f;
+    uint16_t cal = (uint16_t)(5120000000ULL / (ina226_current_lsb_ua * shunt_uohm));
+
+    ina226_write_reg(INA226_REG_CALIB, cal);
+    ina226_write_reg(INA226_REG_CONFIG, INA226_CONFIG_BASE | (avg << 9) | (ct << 6) | (ct << 3) |
+                                            INA226_MODE_CONTINUOUS);
+    ina226_write_reg(INA226_REG_MASK_ENABLE, INA226_CNVR);
+
+    energy_meter_init(&energy, ina226_current_lsb_ua * INA226_POWER_LSB_FACTOR);
+}
+
+// Wait for CVRF; returns ESP_ERR_TIMEOUT if no conversion completed in time
+static esp_err_t ina226_wait_ready(void)
+{
+    int64_t start_us = esp_timer_get_time();
+    for (;;)
+    {
+        uint16_t mask;
+        esp_err_t ret = ina226_read_reg(INA226_REG_MASK_ENABLE, &mask);
+        if (ret != ESP_OK)
+            return ret;
+        if (mask & INA226_CVRF)
+            return ESP_OK;
+        if (esp_timer_get_time() - start_us > INA226_READY_TIMEOUT_US)
+            return ESP_ERR_TIMEOUT;
+        vTaskDelay(1);
+    }
+}
+
+static esp_err_t read_ina226(ina226_data_t *out, uint16_t *power_raw)
 {
-    uint8_t buf[2], reg = INA226_REG_CURRENT;
-    if (i2c_read(ina_dev, reg, buf, 2) != ESP_OK)
+    uint16_t bus, current;
+    if (ina226_read_reg(INA226_REG_BUS_VOLTAGE, &bus) != ESP_OK ||
+        ina226_read_reg(INA226_REG_CURRENT, &current) != ESP_OK ||
+        ina226_read_reg(INA226_REG_POWER, power_raw) != ESP_OK)
         return ESP_FAIL;
-    out->current_a = ((int16_t)((buf[0] << 8) | buf[1])) * ina226_current_lsb;
+    out->bus_voltage_v = bus * INA226_BUS_LSB_V;
+    out->current_a = (int16_t)current * ina226_current_lsb;
+    out->power_w = *power_raw * (INA226_POWER_LSB_FACTOR * ina226_current_lsb);
     return ESP_OK;
 }
 
 static void ina_task(void *arg)
 {
+    // Sleep until shortly before the next conversion completes
+    TickType_t sleep = pdMS_TO_TICKS(INA226_CONVERSION_US / 1000);
+    if (sleep > 1)
+        sleep--;
+    if (sleep < 1)
+        sleep = 1;
+
     ina226_data_t tmp;
+    uint16_t power_raw;
+    int64_t last_read_us = 0, last_save_us = esp_timer_get_time();
     for (;;)
     {
-        if (read_ina226(&tmp) == ESP_OK)
+        vTaskDelay(sleep);
+        if (ina226_wait_ready() != ESP_OK)
+        {
+            stats.ina_timeouts++;
+            continue;
+        }
+        int64_t now = esp_timer_get_time();
+        int64_t sample_us = sensor_hal_time_us(); // same time base as the sample clock
+        if (read_ina226(&tmp, &power_raw) != ESP_OK)
+            continue;
+        stats.ina_conversions++;
+
+        // Each result is the average power since the previous conversion
+        if (last_read_us)
+            energy_meter_add(&energy, power_raw, (uint32_t)(now - last_read_us));
+        last_read_us = now;
+        tmp.energy_wh = energy_meter_wh(&energy);
+        // The result averages the conversion period that just ended
+        resampler_add(&slow_channels, SENSOR_SLOW_CURRENT, sample_us - INA226_CONVERSION_US / 2, tmp.current_a);
+
+        SNAPSHOT_WRITE(&latest_ina, &tmp);
+
+        if (now - last_save_us >= (int64_t)CONFIG_INA226_ENERGY_SAVE_S * 1000000)
         {
-            if (xSemaphoreTake(data_mutex, pdMS_TO_TICKS(20)))
-            {
-                latest_ina = tmp;
-                xSemaphoreGive(data_mutex);
-            }
+            if (energy_meter_save(&energy) != ESP_OK)
+                ESP_LOGW(TAG, "Failed to save energy total");
+            last_save_us = now;
         }
-        vTaskDelay(pdMS_TO_TICKS(100));
     }
 }
+#endif // CONFIG_ENABLE_INA226
 
 // ------------------------- SHTC3 -------------------------
+#if CONFIG_ENABLE_SHTC3
 static uint8_t crc8(const uint8_t *data, int len)
 {
     uint8_t crc = CRC8_INIT;
@@ -237,166 +888,458 @@ static uint8_t crc8(const uint8_t *data, int len)
     return crc;
 }
 
-static esp_err_t shtc3_send_cmd(uint16_t cmd)
+// The SHTC3 is driven by a one-shot esp_timer: every step queues one
+// transaction and its completion arms the timer for the next step, so a
+// measurement never blocks a task. Between measurements the sensor sleeps,
+// which also keeps self-heating out of the readings.
+typedef enum
 {
-    uint8_t buf[2] = {(cmd >> 8) & 0xFF, cmd & 0xFF};
-    esp_err_t ret = ESP_FAIL;
-    if (xSemaphoreTake(i2c_mutex, pdMS_TO_TICKS(20)))
-    {
-        ret = i2c_master_transmit(shtc_dev, buf, 2, -1);
-        xSemaphoreGive(i2c_mutex);
-    }
-    return ret;
-}
+    SHTC3_STATE_WAKE = 0,
+    SHTC3_STATE_MEASURE,
+    SHTC3_STATE_READ,
+    SHTC3_STATE_STORE,
+    SHTC3_STATE_SLEEP,
+} shtc3_state_t;
+
+static esp_timer_handle_t shtc_timer;
+static shtc3_state_t shtc_state;
+static uint32_t shtc_next_delay_us;   // timer delay once the queued transaction is done
+static volatile esp_err_t shtc_result; // of the last queued transaction
+static uint8_t shtc_rx[6];
+static int shtc_retries;
+static int64_t shtc_cycle_start_us;
+static int64_t shtc_cycle_sample_us; // cycle start on the sample clock, for the resampler
 
-static esp_err_t read_shtc3(shtc3_data_t *out)
+// Runs in the bus context: record the result and schedule the next step
+static void shtc3_done(esp_err_t result, void *arg)
 {
-    uint8_t buf[6];
-    if (shtc3_send_cmd(SHTC3_CMD_MEASURE_TF) != ESP_OK)
-        return ESP_FAIL;
+    shtc_result = result;
+    esp_timer_start_once(shtc_timer, shtc_next_delay_us);
+}
 
-    vTaskDelay(pdMS_TO_TICKS(25));
-    esp_err_t ret = ESP_FAIL;
-    if (xSemaphoreTake(i2c_mutex, pdMS_TO_TICKS(20)))
-    {
-        ret = i2c_master_receive(shtc_dev, buf, 6, -1);
-        xSemaphoreGive(i2c_mutex);
-    }
+static void shtc3_submit(shtc3_state_t next, uint32_t delay_us, uint16_t cmd, uint8_t *rx, size_t rx_len)
+{
+    uint8_t tx[2] = {(cmd >> 8) & 0xFF, cmd & 0xFF};
+    shtc_state = next;
+    shtc_next_delay_us = delay_us;
+    stats.i2c_transactions++;
+    esp_err_t ret = sensor_hal_submit(shtc_dev, tx, rx ? 0 : 2, rx, rx_len, shtc3_done, NULL);
     if (ret != ESP_OK)
-        return ret;
+        shtc3_done(ret, NULL); // queue full: continue as if the transaction failed
+}
 
+static void shtc3_sleep_until_next(void)
+{
+    int64_t elapsed = esp_timer_get_time() - shtc_cycle_start_us;
+    int64_t wait = (int64_t)CONFIG_SHTC3_INTERVAL_MS * 1000 - elapsed;
+    shtc_state = SHTC3_STATE_WAKE;
+    esp_timer_start_once(shtc_timer, wait > 0 ? wait : 0);
+}
+
+static esp_err_t decode_shtc3(const uint8_t *buf, shtc3_data_t *out)
+{
     if (crc8(buf, 2) != buf[2] || crc8(buf + 3, 2) != buf[5])
         return ESP_ERR_INVALID_CRC;
 
-    uint16_t raw_t = (buf[3] << 8) | buf[4];
-    uint16_t raw_h = (buf[0] << 8) | buf[1];
+    // The measure command returns temperature first, then humidity
+    uint16_t raw_t = (buf[0] << 8) | buf[1];
+    uint16_t raw_h = (buf[3] << 8) | buf[4];
     out->temperature_c = -45.0f + 175.0f * ((float)raw_t / 65536.0f);
     out->humidity_rh = 100.0f * ((float)raw_h / 65536.0f);
-
     return ESP_OK;
 }
 
-static void shtc_task(void *arg)
+// esp_timer callback (timer task)
+static void shtc3_step(void *arg)
 {
-    shtc3_data_t tmp;
-    for (;;)
+    switch (shtc_state)
     {
-        if (read_shtc3(&tmp) == ESP_OK)
+    case SHTC3_STATE_WAKE:
+        shtc_cycle_start_us = esp_timer_get_time();
+        shtc_cycle_sample_us = sensor_hal_time_us();
+        shtc_retries = 0;
+        shtc3_submit(SHTC3_STATE_MEASURE, SHTC3_WAKEUP_US, SHTC3_CMD_WAKEUP, NULL, 0);
+        break;
+
+    case SHTC3_STATE_MEASURE:
+        if (shtc_result != ESP_OK)
+        {
+            shtc3_sleep_until_next();
+            break;
+        }
+        shtc3_submit(SHTC3_STATE_READ, SHTC3_MEASURE_US, SHTC3_CMD_MEASURE, NULL, 0);
+        break;
+
+    case SHTC3_STATE_READ:
+        if (shtc_result != ESP_OK)
         {
-            if (xSemaphoreTake(data_mutex, pdMS_TO_TICKS(20)))
-            {
-                latest_shtc = tmp;
-                xSemaphoreGive(data_mutex);
-            }
+            shtc3_submit(SHTC3_STATE_SLEEP, 0, SHTC3_CMD_SLEEP, NULL, 0);
+            break;
         }
-        vTaskDelay(pdMS_TO_TICKS(1000));
+        shtc3_submit(SHTC3_STATE_STORE, 0, 0, shtc_rx, sizeof(shtc_rx));
+        break;
+
+    case SHTC3_STATE_STORE:
+    {
+        if (shtc_result != ESP_OK && shtc_retries++ < SHTC3_READ_RETRIES)
+        {
+            shtc_state = SHTC3_STATE_READ;
+            shtc_result = ESP_OK;
+            esp_timer_start_once(shtc_timer, SHTC3_READ_RETRY_US);
+            break;
+        }
+        shtc3_data_t tmp;
+        if (shtc_result == ESP_OK && decode_shtc3(shtc_rx, &tmp) == ESP_OK)
+        {
+            resampler_add(&slow_channels, SENSOR_SLOW_TEMPERATURE,
+                          shtc_cycle_sample_us + SHTC3_WAKEUP_US + SHTC3_MEASURE_US / 2, tmp.temperature_c);
+            SNAPSHOT_WRITE(&latest_shtc, &tmp);
+        }
+        shtc3_submit(SHTC3_STATE_SLEEP, 0, SHTC3_CMD_SLEEP, NULL, 0);
+        break;
+    }
+
+    case SHTC3_STATE_SLEEP:
+        shtc3_sleep_until_next();
+        break;
     }
 }
 
+static esp_err_t shtc3_start(void)
+{
+    esp_timer_create_args_t timer_args = {
+        .callback = shtc3_step,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "shtc3"};
+    esp_err_t ret = esp_timer_create(&timer_args, &shtc_timer);
+    if (ret != ESP_OK)
+        return ret;
+    shtc_state = SHTC3_STATE_WAKE;
+    return esp_timer_start_once(shtc_timer, 0);
+}
+#endif // CONFIG_ENABLE_SHTC3
+
 // ------------------------- Public API -------------------------
+static bool stream_pop(synchronized_sample_t *out)
+{
+    if (!sample_ring_pop(&stream_ring, out))
+        return false;
+    resampler_fill(&slow_channels, out, 1);
+    return true;
+}
+
 bool sensor_manager_get_next_sample(synchronized_sample_t *out, TickType_t timeout)
 {
-    return (xQueueReceive(stream_queue, out, timeout) == pdTRUE);
+    TickType_t start = xTaskGetTickCount();
+    for (;;)
+    {
+        if (stream_pop(out))
+            return true;
+
+        TickType_t wait = portMAX_DELAY;
+        if (timeout != portMAX_DELAY)
+        {
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            if (elapsed >= timeout)
+                return false;
+            wait = timeout - elapsed;
+        }
+        // The semaphore may be stale from an already consumed push; loop
+        if (xSemaphoreTake(stream_sem, wait) != pdTRUE)
+            return stream_pop(out);
+    }
+}
+
+sensor_bus_sub_t sensor_manager_subscribe(const char *name, uint32_t decimation)
+{
+    return sample_bus_subscribe(&sample_bus, name, decimation);
 }
 
-bool sensor_manager_get_batch(synchronized_sample_t *out_batch, int *out_count, TickType_t timeout)
+void sensor_manager_unsubscribe(sensor_bus_sub_t sub)
 {
-    if (xQueueReceive(batch_queue, out_batch, timeout) == pdTRUE)
+    if (sub)
+        sample_bus_unsubscribe(sub);
+}
+
+const synchronized_sample_t *sensor_manager_bus_acquire(sensor_bus_sub_t sub, TickType_t timeout)
+{
+    return sample_bus_acquire(sub, timeout);
+}
+
+bool sensor_manager_bus_release(sensor_bus_sub_t sub)
+{
+    return sample_bus_release(sub);
+}
+
+void sensor_manager_bus_get_stats(sensor_bus_sub_t sub, sensor_bus_sub_stats_t *out)
+{
+    *out = sub->stats;
+}
+
+bool sensor_manager_get_batch(const synchronized_sample_t **out_batch, int *out_count, TickType_t timeout)
+{
+    synchronized_sample_t *batch;
+    if (xQueueReceive(batch_queue, &batch, timeout) == pdTRUE)
     {
+        // The batch belongs to the caller now; merge the slow channels here
+        // rather than in the capture task
+        resampler_fill(&slow_channels, batch, BATCH_SIZE);
+        *out_batch = batch;
         *out_count = BATCH_SIZE;
         return true;
     }
     return false;
 }
 
-bool sensor_manager_get_latest_environment(shtc3_data_t *out)
+void sensor_manager_fill_slow_channels(synchronized_sample_t *samples, size_t count)
 {
-    if (xSemaphoreTake(data_mutex, pdMS_TO_TICKS(10)))
+    if (samples && count)
+        resampler_fill(&slow_channels, samples, count);
+}
+
+void sensor_manager_release_batch(const synchronized_sample_t *batch)
+{
+    if (batch)
+        xQueueSend(batch_free_queue, &batch, 0);
+}
+
+void sensor_manager_set_batch_capture(bool enable)
+{
+    batch_capture_enabled = enable;
+    if (enable)
+        return;
+
+    // Completed batches can go back right away; the partial one belongs to
+    // mpu_task, which also catches a batch it completed meanwhile
+    synchronized_sample_t *buf;
+    while (xQueueReceive(batch_queue, &buf, 0) == pdTRUE)
+        xQueueSend(batch_free_queue, &buf, 0);
+    batch_flush_request = true;
+}
+
+esp_err_t sensor_manager_set_stream_rate(int rate_hz)
+{
+    if (!decimator_rate_supported(SAMPLE_RATE_HZ, rate_hz))
+        return ESP_ERR_INVALID_ARG;
+    stream_rate_request = rate_hz;
+    return ESP_OK;
+}
+
+bool sensor_manager_get_spectrum(sensor_spectrum_t *out, TickType_t timeout)
+{
+#if CONFIG_SENSOR_FFT_ENABLE
+    return spectrum_get(out, timeout);
+#else
+    return false;
+#endif
+}
+
+bool sensor_manager_get_stats(sensor_manager_stats_t *out)
+{
+    if (!out)
+        return false;
+    *out = stats;
+    out->stream_dropped = sample_ring_dropped(&stream_ring);
+    out->batch_buffers_free = uxQueueMessagesWaiting(batch_free_queue);
+#if CONFIG_SENSOR_FFT_ENABLE
+    spectrum_get_timing(&out->fft_frames, &out->fft_last_us, &out->fft_max_us);
+#endif
+    sensor_hal_dev_stats_t bus;
+    sensor_hal_get_stats(mpu_dev, &bus);
+    out->i2c_errors = bus.errors;
+    out->i2c_mpu_wait_max_us = bus.wait_max_us;
+    sensor_hal_get_stats(ina_dev, &bus);
+    out->i2c_errors += bus.errors;
+    sensor_hal_get_stats(shtc_dev, &bus);
+    out->i2c_errors += bus.errors;
+    return true;
+}
+
+bool sensor_manager_get_health(sensor_health_t *out)
+{
+    if (!out)
+        return false;
+    if (!SNAPSHOT_READ(&latest_health, out))
+        memset(out, 0, sizeof(*out)); // no overflow so far
+
+    sensor_hal_dev_stats_t bus;
+    out->i2c_errors = 0;
+    sensor_hal_dev_t *devs[] = {mpu_dev, ina_dev, shtc_dev};
+    for (int i = 0; i < 3; i++)
+    {
+        sensor_hal_get_stats(devs[i], &bus);
+        out->i2c_errors += bus.errors;
+    }
+    out->ina_timeouts = stats.ina_timeouts;
+    return true;
+}
+
+bool sensor_manager_get_history_range(uint32_t *oldest_seq, uint32_t *next_seq)
+{
+#if CONFIG_SENSOR_HISTORY_SECONDS > 0
+    if (history_ready)
     {
-        *out = latest_shtc;
-        xSemaphoreGive(data_mutex);
+        sample_history_range(&history, oldest_seq, next_seq);
         return true;
     }
+#endif
     return false;
 }
 
+size_t sensor_manager_read_history_raw(uint32_t start_seq, sensor_raw_record_t *out, size_t max_count)
+{
+#if CONFIG_SENSOR_HISTORY_SECONDS > 0
+    if (history_ready)
+        return sample_history_read_raw(&history, start_seq, out, max_count);
+#endif
+    return 0;
+}
+
+size_t sensor_manager_read_history(uint32_t start_seq, synchronized_sample_t *out, size_t max_count)
+{
+#if CONFIG_SENSOR_HISTORY_SECONDS > 0
+    if (history_ready)
+        return sample_history_read(&history, start_seq, out, max_count);
+#endif
+    return 0;
+}
+
+bool sensor_manager_get_vibration_stats(sensor_vib_window_t window, sensor_vibration_stats_t *out)
+{
+    if (window > SENSOR_VIB_WINDOW_TUMBLING)
+        return false;
+    return SNAPSHOT_READ(&latest_vib[window], out);
+}
+
+bool sensor_manager_get_attitude(sensor_attitude_t *out)
+{
+    return SNAPSHOT_READ(&latest_attitude, out);
+}
+
+void sensor_manager_set_attitude_reference(void)
+{
+    attitude_ref_request = true;
+}
+
+bool sensor_manager_get_latest_power(ina226_data_t *out)
+{
+    return SNAPSHOT_READ(&latest_ina, out);
+}
+
+bool sensor_manager_get_latest_environment(shtc3_data_t *out)
+{
+    return SNAPSHOT_READ(&latest_shtc, out);
+}
+
+esp_err_t sensor_manager_calibrate_mpu(void)
+{
+#if CONFIG_MPU6050_CALIBRATE_ON_START
+    calib_request = true;
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t sensor_manager_write_trace(FILE *f)
+{
+    return sensor_hal_trace_write(f);
+}
+
 esp_err_t sensor_manager_init(void)
 {
     // I2C bus
-    i2c_master_bus_config_t cfg = {
-        .i2c_port = I2C_NUM_0,
-        .sda_io_num = 15,
-        .scl_io_num = 16,
-        .clk_source = I2C_CLK_SRC_DEFAULT,
-        .glitch_ignore_cnt = 7,
-        .flags.enable_internal_pullup = false};
-    ESP_ERROR_CHECK(i2c_new_master_bus(&cfg, &bus_handle));
-
-    i2c_device_config_t dev_cfg = {
-        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
-        .scl_speed_hz = 400000};
+    sensor_hal_bus_config_t cfg = {
+        .port = 0,
+        .sda_io = 15,
+        .scl_io = 16};
+    ESP_ERROR_CHECK(sensor_hal_init(&cfg));
 
     // OS objects
-    i2c_mutex = xSemaphoreCreateMutex();
-    data_mutex = xSemaphoreCreateMutex();
     mpu_sem = xSemaphoreCreateBinary();
+    fifo_buf = heap_caps_malloc(FIFO_BURST_MAX_BYTES, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
 
-    stream_queue = xQueueCreate(STREAM_QUEUE_LEN, sizeof(synchronized_sample_t));
-    // batch_queue = xQueueCreate(BATCH_QUEUE_LEN, sizeof(synchronized_sample_t) * BATCH_SIZE);
-    batch_queue = xQueueCreate(BATCH_QUEUE_LEN, sizeof(synchronized_sample_t *));
+    stream_sem = xSemaphoreCreateBinary();
+    sample_ring_init(&stream_ring, stream_slots, STREAM_RING_LEN);
+    resampler_init(&slow_channels);
+    vib_stats_init(&vib_stats, SAMPLE_RATE_HZ);
+    attitude_init(&attitude, SAMPLE_RATE_HZ);
+    if (decimator_init(&stream_decim, SAMPLE_RATE_HZ, CONFIG_SENSOR_STREAM_RATE_HZ) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Unsupported stream rate %d Hz", CONFIG_SENSOR_STREAM_RATE_HZ);
+        return ESP_ERR_INVALID_ARG;
+    }
+    batch_queue = xQueueCreate(BATCH_POOL_LEN, sizeof(synchronized_sample_t *));
+    batch_free_queue = xQueueCreate(BATCH_POOL_LEN, sizeof(synchronized_sample_t *));
 
-    if (!i2c_mutex || !data_mutex || !mpu_sem || !stream_queue || !batch_queue)
+    if (!mpu_sem || !stream_sem || !batch_queue || !batch_free_queue || !fifo_buf)
     {
         ESP_LOGE(TAG, "Failed to allocate RTOS objects (queue/semaphore creation failed)");
         return ESP_ERR_NO_MEM;
     }
 
+    // Batch pool lives in PSRAM; 28 KB per buffer is too much for internal RAM
+    for (int i = 0; i < BATCH_POOL_LEN; i++)
+    {
+        synchronized_sample_t *buf = heap_caps_malloc(BATCH_SIZE * sizeof(synchronized_sample_t), MALLOC_CAP_SPIRAM);
+        if (!buf)
+            buf = heap_caps_malloc(BATCH_SIZE * sizeof(synchronized_sample_t), MALLOC_CAP_DEFAULT);
+        if (!buf)
+        {
+            ESP_LOGE(TAG, "Failed to allocate batch buffer %d", i);
+            return ESP_ERR_NO_MEM;
+        }
+        xQueueSend(batch_free_queue, &buf, 0);
+    }
+
+    if (sample_bus_init(&sample_bus, CONFIG_SENSOR_BUS_SAMPLES) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to allocate sample bus");
+        return ESP_ERR_NO_MEM;
+    }
+
+#if CONFIG_SENSOR_HISTORY_SECONDS > 0
+    // Not fatal: the live paths work without it
+    if (sample_history_init(&history, CONFIG_SENSOR_HISTORY_SECONDS * SAMPLE_RATE_HZ) == ESP_OK)
+        history_ready = true;
+    else
+        ESP_LOGW(TAG, "Failed to allocate %d s sample history", CONFIG_SENSOR_HISTORY_SECONDS);
+#endif
+
+#if CONFIG_SENSOR_FFT_ENABLE
+    if (spectrum_init(SAMPLE_RATE_HZ) != ESP_OK)
+        return ESP_ERR_NO_MEM;
+#endif
+
     // MPU
-    dev_cfg.device_address = MPU_ADDR;
-    ESP_ERROR_CHECK(i2c_master_bus_add_device(bus_handle, &dev_cfg, &mpu_dev));
+    ESP_ERROR_CHECK(sensor_hal_add_device(MPU_ADDR, 400000, SENSOR_HAL_PRIO_HIGH, "mpu6050", &mpu_dev));
     mpu_init();
 
+#if CONFIG_ENABLE_INA226
     // INA
-    dev_cfg.device_address = INA226_DEVICE_ADDRESS;
-    ESP_ERROR_CHECK(i2c_master_bus_add_device(bus_handle, &dev_cfg, &ina_dev));
-    float max_current = 5.0f, shunt = 0.1f;
-    ina226_current_lsb = max_current / 32768.0f;
-    uint16_t cal = (uint16_t)(0.00512 / (ina226_current_lsb * shunt));
-    uint8_t cal_cmd[3] = {INA226_REG_CALIB, (cal >> 8) & 0xFF, cal & 0xFF};
-    if (xSemaphoreTake(i2c_mutex, pdMS_TO_TICKS(20)))
-    {
-        i2c_master_transmit(ina_dev, cal_cmd, 3, -1);
-        uint8_t cfg_cmd[3] = {INA226_REG_CONFIG, (INA226_DEFAULT_CONFIG >> 8) & 0xFF,
-                              INA226_DEFAULT_CONFIG & 0xFF};
-        i2c_master_transmit(ina_dev, cfg_cmd, 3, -1);
-        xSemaphoreGive(i2c_mutex);
-    }
+    ESP_ERROR_CHECK(sensor_hal_add_device(INA226_DEVICE_ADDRESS, 400000, SENSOR_HAL_PRIO_NORMAL, "ina226", &ina_dev));
+    ina226_init();
+#endif
 
+#if CONFIG_ENABLE_SHTC3
     // SHTC3
-    dev_cfg.device_address = SHTC3_ADDR;
-    ESP_ERROR_CHECK(i2c_master_bus_add_device(bus_handle, &dev_cfg, &shtc_dev));
-    uint8_t wake_cmd[2] = {(SHTC3_CMD_WAKEUP >> 8) & 0xFF, SHTC3_CMD_WAKEUP & 0xFF};
-    if (xSemaphoreTake(i2c_mutex, pdMS_TO_TICKS(20)))
-    {
-        i2c_master_transmit(shtc_dev, wake_cmd, 2, -1);
-        xSemaphoreGive(i2c_mutex);
-    }
-    vTaskDelay(pdMS_TO_TICKS(100));
+    ESP_ERROR_CHECK(sensor_hal_add_device(SHTC3_ADDR, 400000, SENSOR_HAL_PRIO_LOW, "shtc3", &shtc_dev));
+#endif
 
     // Tasks
     xTaskCreatePinnedToCore(mpu_task, "mpu_task", 6144, NULL, 12, NULL, 1);
-    xTaskCreatePinnedToCore(ina_task, "ina_task", 2048, NULL, 6, NULL, 1);
-    xTaskCreatePinnedToCore(shtc_task, "shtc_task", 4096, NULL, 5, NULL, 1);
-
-    // GPIO INT
-    gpio_config_t io_conf = {
-        .intr_type = GPIO_INTR_POSEDGE,
-        .mode = GPIO_MODE_INPUT,
-        .pin_bit_mask = (1ULL << MPU_INT_PIN),
-        .pull_up_en = 0};
-    gpio_config(&io_conf);
-    gpio_install_isr_service(0);
-    gpio_isr_handler_add(MPU_INT_PIN, mpu_isr, NULL);
+#if CONFIG_ENABLE_INA226
+    xTaskCreatePinnedToCore(ina_task, "ina_task", 3072, NULL, 6, NULL, 1);
+#endif
+#if CONFIG_ENABLE_SHTC3
+    ESP_ERROR_CHECK(shtc3_start());
+#endif
+
+    // MPU wake sources: INT pin, plus the watermark timer in coalesced mode
+    ESP_ERROR_CHECK(sensor_hal_attach_irq(MPU_INT_PIN, mpu_wake, NULL));
+#if CONFIG_MPU6050_ACQ_WATERMARK
+    ESP_ERROR_CHECK(sensor_hal_start_timer(MPU_WAKE_PERIOD_US, mpu_wake, NULL));
+#endif
 
     ESP_LOGI(TAG, "Sensor manager initialized.");
     return ESP_OK;
@@ -0,0 +1,33 @@
+#include "snapshot.h"
+#include <stdint.h>
+#include <string.h>
+
+// Readers use copy[seq & 1]. An odd seq moves them to copy[1] while copy[0]
+// is rewritten, the next (even) value moves them back while copy[1] catches up.
+void snapshot_write(snapshot_t *sn, void *copies, const void *value, size_t size)
+{
+    uint8_t *c = copies;
+    unsigned seq = atomic_load_explicit(&sn->seq, memory_order_relaxed);
+
+    atomic_store_explicit(&sn->seq, seq + 1, memory_order_release);
+    atomic_thread_fence(memory_order_release);
+    memcpy(c, value, size);
+
+    atomic_store_explicit(&sn->seq, seq + 2, memory_order_release);
+    atomic_thread_fence(memory_order_release);
+    memcpy(c + size, value, size);
+}
+
+bool snapshot_read(const snapshot_t *sn, const void *copies, void *out, size_t size)
+{
+    for (;;)
+    {
+        unsigned seq = atomic_load_explicit(&sn->seq, memory_order_acquire);
+        if (seq < 2)
+            return false;
+        memcpy(out, (const uint8_t *)copies + (seq & 1) * size, size);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&sn->seq, memory_order_relaxed) == seq)
+            return true;
+    }
+}
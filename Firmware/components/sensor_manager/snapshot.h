@@ -0,0 +1,37 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Latest-value cell with one writer and wait-free readers. The value is kept
+// twice and a sequence counter says which copy is stable: the writer updates
+// one copy while readers use the other, then flips. A reader never waits for
+// the writer, even one preempted halfway through an update; it only retries
+// if the writer completed a flip while it was copying.
+
+typedef struct
+{
+    atomic_uint seq; // writes begun + writes completed; below 2 until the first write
+} snapshot_t;
+
+#define SNAPSHOT_CELL(type) \
+    struct                  \
+    {                       \
+        snapshot_t sn;      \
+        type copy[2];       \
+    }
+
+void snapshot_write(snapshot_t *sn, void *copies, const void *value, size_t size);
+
+/**
+ * @return false if nothing was written yet (out untouched)
+ */
+bool snapshot_read(const snapshot_t *sn, const void *copies, void *out, size_t size);
+
+// Typed wrappers for cells declared with SNAPSHOT_CELL()
+#define SNAPSHOT_WRITE(cell, value) snapshot_write(&(cell)->sn, (cell)->copy, (value), sizeof((cell)->copy[0]))
+#define SNAPSHOT_READ(cell, out) snapshot_read(&(cell)->sn, (cell)->copy, (out), sizeof((cell)->copy[0]))
+
+#endif // SNAPSHOT_H
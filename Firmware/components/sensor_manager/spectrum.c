@@ -0,0 +1,184 @@
+#include "spectrum.h"
+#include "dsps_fft2r.h"
+#include "dsps_wind_hann.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "SPECTRUM";
+
+#define FFT_SIZE CONFIG_SENSOR_FFT_SIZE
+#define FFT_HOP CONFIG_SENSOR_FFT_HOP
+#define FFT_TOP_K CONFIG_SENSOR_FFT_TOP_K
+#define FFT_RING_LEN (2 * FFT_SIZE) // the task has FFT_SIZE samples of slack to copy a frame
+
+#if FFT_HOP > FFT_SIZE
+#error "CONFIG_SENSOR_FFT_HOP must not exceed CONFIG_SENSOR_FFT_SIZE"
+#endif
+#if FFT_TOP_K > SENSOR_SPECTRUM_MAX_PEAKS
+#error "CONFIG_SENSOR_FFT_TOP_K must not exceed SENSOR_SPECTRUM_MAX_PEAKS"
+#endif
+
+static float *ring;     // raw input, written by mpu_task
+static float *window;   // Hann window
+static float *work;     // interleaved complex FFT buffer
+static float window_sum;
+static int rate_hz;
+
+static uint32_t ring_pos;     // mpu_task only
+static uint32_t hop_count;    // mpu_task only
+static TaskHandle_t spectrum_task_handle;
+static volatile uint64_t frame_end_timestamp_us;
+static QueueHandle_t spectrum_queue; // length 1, latest spectrum wins
+
+static uint32_t fft_frames, fft_last_us, fft_max_us;
+
+void spectrum_push(float value, uint64_t timestamp_us)
+{
+    ring[ring_pos] = value;
+    ring_pos = (ring_pos + 1 == FFT_RING_LEN) ? 0 : ring_pos + 1;
+
+    if (++hop_count >= FFT_HOP)
+    {
+        hop_count = 0;
+        frame_end_timestamp_us = timestamp_us;
+        // Notification value = ring index one past the newest sample
+        xTaskNotify(spectrum_task_handle, ring_pos, eSetValueWithOverwrite);
+    }
+}
+
+// Local maxima, strongest first, with parabolic interpolation of the peak bin
+static int spectrum_find_peaks(const float *mag, int bins, sensor_spectrum_peak_t *peaks)
+{
+    int count = 0;
+    for (int k = 2; k < bins - 1; k++)
+    {
+        float m = mag[k];
+        if (m <= mag[k - 1] || m < mag[k + 1])
+            continue;
+        if (count == FFT_TOP_K && m <= peaks[count - 1].amplitude_g)
+            continue;
+
+        float a = mag[k - 1], b = m, c = mag[k + 1];
+        float denom = a - 2.0f * b + c;
+        float delta = denom != 0.0f ? 0.5f * (a - c) / denom : 0.0f;
+
+        int i = count < FFT_TOP_K ? count++ : FFT_TOP_K - 1;
+        while (i > 0 && peaks[i - 1].amplitude_g < m)
+        {
+            peaks[i] = peaks[i - 1];
+            i--;
+        }
+        peaks[i].freq_hz = (k + delta) * rate_hz / (float)FFT_SIZE;
+        peaks[i].amplitude_g = b - 0.25f * (a - c) * delta;
+    }
+    return count;
+}
+
+static void spectrum_task(void *arg)
+{
+    uint32_t end;
+    sensor_spectrum_t result;
+
+    for (;;)
+    {
+        if (xTaskNotifyWait(0, 0, &end, portMAX_DELAY) != pdTRUE)
+            continue;
+        uint64_t timestamp_us = frame_end_timestamp_us;
+        int64_t start_us = esp_timer_get_time();
+
+        // Copy out the newest FFT_SIZE samples and remove their mean
+        uint32_t idx = (end + FFT_RING_LEN - FFT_SIZE) % FFT_RING_LEN;
+        float mean = 0.0f;
+        for (int i = 0; i < FFT_SIZE; i++)
+        {
+            float v = ring[idx];
+            idx = (idx + 1 == FFT_RING_LEN) ? 0 : idx + 1;
+            work[2 * i] = v;
+            mean += v;
+        }
+        mean /= FFT_SIZE;
+
+        float sum_sq = 0.0f;
+        for (int i = 0; i < FFT_SIZE; i++)
+        {
+            float v = work[2 * i] - mean;
+            sum_sq += v * v;
+            work[2 * i] = v * window[i];
+            work[2 * i + 1] = 0.0f;
+        }
+
+        dsps_fft2r_fc32(work, FFT_SIZE);
+        dsps_bit_rev_fc32(work, FFT_SIZE);
+
+        // Single-sided amplitude spectrum, in place over the real parts
+        float scale = 2.0f / window_sum;
+        int bins = FFT_SIZE / 2;
+        for (int k = 0; k < bins; k++)
+        {
+            float re = work[2 * k], im = work[2 * k + 1];
+            work[k] = sqrtf(re * re + im * im) * scale;
+        }
+
+        result.timestamp_us = timestamp_us;
+        result.rms_g = sqrtf(sum_sq / FFT_SIZE);
+        result.resolution_hz = rate_hz / (float)FFT_SIZE;
+        result.num_peaks = spectrum_find_peaks(work, bins, result.peaks);
+
+        uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start_us);
+        result.compute_us = elapsed;
+        fft_last_us = elapsed;
+        if (elapsed > fft_max_us)
+            fft_max_us = elapsed;
+        fft_frames++;
+
+        xQueueOverwrite(spectrum_queue, &result);
+    }
+}
+
+esp_err_t spectrum_init(int sample_rate_hz)
+{
+    rate_hz = sample_rate_hz;
+    ring = heap_caps_calloc(FFT_RING_LEN, sizeof(float), MALLOC_CAP_INTERNAL);
+    window = heap_caps_aligned_alloc(16, FFT_SIZE * sizeof(float), MALLOC_CAP_INTERNAL);
+    work = heap_caps_aligned_alloc(16, 2 * FFT_SIZE * sizeof(float), MALLOC_CAP_INTERNAL);
+    spectrum_queue = xQueueCreate(1, sizeof(sensor_spectrum_t));
+    if (!ring || !window || !work || !spectrum_queue)
+    {
+        ESP_LOGE(TAG, "Failed to allocate FFT buffers");
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = dsps_fft2r_init_fc32(NULL, FFT_SIZE);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "FFT init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    dsps_wind_hann_f32(window, FFT_SIZE);
+    window_sum = 0.0f;
+    for (int i = 0; i < FFT_SIZE; i++)
+        window_sum += window[i];
+
+    if (xTaskCreatePinnedToCore(spectrum_task, "spectrum", 3072, NULL, 4, &spectrum_task_handle, 0) != pdPASS)
+        return ESP_ERR_NO_MEM;
+    return ESP_OK;
+}
+
+bool spectrum_get(sensor_spectrum_t *out, TickType_t timeout)
+{
+    return spectrum_queue && xQueueReceive(spectrum_queue, out, timeout) == pdTRUE;
+}
+
+void spectrum_get_timing(uint32_t *frames, uint32_t *last_us, uint32_t *max_us)
+{
+    *frames = fft_frames;
+    *last_us = fft_last_us;
+    *max_us = fft_max_us;
+}
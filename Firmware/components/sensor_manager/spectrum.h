@@ -0,0 +1,31 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include "sensor_manager.h"
+
+// Vibration spectrum engine. mpu_task feeds every raw sample; a separate
+// low-priority task runs a Hann-windowed FFT over the last
+// CONFIG_SENSOR_FFT_SIZE samples every CONFIG_SENSOR_FFT_HOP samples and
+// keeps the strongest peaks.
+
+/**
+ * @brief Allocate buffers, build FFT tables and start the spectrum task.
+ */
+esp_err_t spectrum_init(int sample_rate_hz);
+
+/**
+ * @brief Feed one sample (mpu_task only).
+ */
+void spectrum_push(float value, uint64_t timestamp_us);
+
+/**
+ * @brief Wait for the next spectrum.
+ */
+bool spectrum_get(sensor_spectrum_t *out, TickType_t timeout);
+
+/**
+ * @brief FFT frame count and compute time, for sensor_manager_get_stats().
+ */
+void spectrum_get_timing(uint32_t *frames, uint32_t *last_us, uint32_t *max_us);
+
+#endif // SPECTRUM_H
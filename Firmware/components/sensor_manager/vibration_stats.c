@@ -0,0 +1,129 @@
+#include "vibration_stats.h"
+#include <math.h>
+#include <string.h>
+
+static void moments_reset(vib_moments_t *m)
+{
+    memset(m, 0, sizeof(*m));
+    m->min = INFINITY;
+    m->max = -INFINITY;
+}
+
+static inline void moments_add(vib_moments_t *m, float x)
+{
+    float n1 = m->n;
+    float n = n1 + 1.0f;
+    float delta = x - m->mean;
+    float delta_n = delta / n;
+    float delta_n2 = delta_n * delta_n;
+    float term1 = delta * delta_n * n1;
+
+    m->mean += delta_n;
+    m->m4 += term1 * delta_n2 * (n * n - 3.0f * n + 3.0f) + 6.0f * delta_n2 * m->m2 - 4.0f * delta_n * m->m3;
+    m->m3 += term1 * delta_n * (n - 2.0f) - 3.0f * delta_n * m->m2;
+    m->m2 += term1;
+    m->n = n;
+
+    if (x < m->min)
+        m->min = x;
+    if (x > m->max)
+        m->max = x;
+}
+
+static void moments_merge(vib_moments_t *a, const vib_moments_t *b)
+{
+    if (b->n == 0.0f)
+        return;
+    if (a->n == 0.0f)
+    {
+        *a = *b;
+        return;
+    }
+
+    float na = a->n, nb = b->n, n = na + nb;
+    float delta = b->mean - a->mean;
+    float d2 = delta * delta;
+    float nanb = na * nb;
+
+    float m2 = a->m2 + b->m2 + d2 * nanb / n;
+    float m3 = a->m3 + b->m3 + d2 * delta * nanb * (na - nb) / (n * n) +
+               3.0f * delta * (na * b->m2 - nb * a->m2) / n;
+    float m4 = a->m4 + b->m4 + d2 * d2 * nanb * (na * na - nanb + nb * nb) / (n * n * n) +
+               6.0f * d2 * (na * na * b->m2 + nb * nb * a->m2) / (n * n) +
+               4.0f * delta * (na * b->m3 - nb * a->m3) / n;
+
+    a->mean += delta * nb / n;
+    a->m2 = m2;
+    a->m3 = m3;
+    a->m4 = m4;
+    a->n = n;
+    if (b->min < a->min)
+        a->min = b->min;
+    if (b->max > a->max)
+        a->max = b->max;
+}
+
+static void moments_to_stats(const vib_moments_t *m, sensor_axis_stats_t *out)
+{
+    float var = m->n > 0.0f ? m->m2 / m->n : 0.0f;
+    out->rms_g = sqrtf(var);
+    // Peak deviation from the window mean (gravity removed)
+    out->peak_g = fmaxf(m->max - m->mean, m->mean - m->min);
+    out->crest_factor = out->rms_g > 0.0f ? out->peak_g / out->rms_g : 0.0f;
+    out->skewness = var > 0.0f ? (m->m3 / m->n) / (var * out->rms_g) : 0.0f;
+    out->kurtosis = var > 0.0f ? (m->m4 / m->n) / (var * var) : 0.0f;
+}
+
+void vib_stats_init(vib_stats_t *vs, int sample_rate_hz)
+{
+    memset(vs, 0, sizeof(*vs));
+    vs->block_samples = sample_rate_hz * VIB_BLOCK_MS / 1000;
+    for (int a = 0; a < VIB_AXES; a++)
+        moments_reset(&vs->current[a]);
+}
+
+int vib_stats_push(vib_stats_t *vs, const float accel[VIB_AXES], uint64_t timestamp_us,
+                   sensor_vibration_stats_t *sliding, sensor_vibration_stats_t *tumbling)
+{
+    for (int a = 0; a < VIB_AXES; a++)
+        moments_add(&vs->current[a], accel[a]);
+
+    if (++vs->block_fill < vs->block_samples)
+        return 0;
+
+    // Close the block
+    memcpy(vs->blocks[vs->block_pos], vs->current, sizeof(vs->current));
+    vs->block_pos = (vs->block_pos + 1) % VIB_WINDOW_BLOCKS;
+    if (vs->blocks_valid < VIB_WINDOW_BLOCKS)
+        vs->blocks_valid++;
+    vs->block_fill = 0;
+    for (int a = 0; a < VIB_AXES; a++)
+        moments_reset(&vs->current[a]);
+
+    // Merge the window, oldest block first
+    vib_moments_t window[VIB_AXES];
+    for (int a = 0; a < VIB_AXES; a++)
+        moments_reset(&window[a]);
+    int first = (vs->block_pos + VIB_WINDOW_BLOCKS - vs->blocks_valid) % VIB_WINDOW_BLOCKS;
+    for (int i = 0; i < vs->blocks_valid; i++)
+    {
+        int b = (first + i) % VIB_WINDOW_BLOCKS;
+        for (int a = 0; a < VIB_AXES; a++)
+            moments_merge(&window[a], &vs->blocks[b][a]);
+    }
+
+    sliding->timestamp_us = timestamp_us;
+    sliding->window_ms = vs->blocks_valid * VIB_BLOCK_MS;
+    sliding->samples = (uint32_t)window[0].n;
+    for (int a = 0; a < VIB_AXES; a++)
+        moments_to_stats(&window[a], &sliding->axis[a]);
+
+    int ready = VIB_STATS_SLIDING_READY;
+    if (++vs->blocks_since_tumble >= VIB_WINDOW_BLOCKS && vs->blocks_valid == VIB_WINDOW_BLOCKS)
+    {
+        vs->blocks_since_tumble = 0;
+        *tumbling = *sliding;
+        ready |= VIB_STATS_TUMBLING_READY;
+    }
+    return ready;
+}
@@ -0,0 +1,52 @@
+#ifndef VIBRATION_STATS_H
+#define VIBRATION_STATS_H
+
+#include "sensor_manager.h"
+
+// Streaming per-axis vibration statistics. Each sample updates running
+// central moments (Welford/Terriberry) of the current block in O(1); every
+// VIB_BLOCK_SAMPLES the block is closed and the last VIB_WINDOW_BLOCKS block
+// summaries are merged (Pebay) into the sliding window. Every
+// VIB_WINDOW_BLOCKS blocks the sliding result is also the tumbling one.
+
+#define VIB_AXES 3
+#define VIB_BLOCK_MS 100
+// Rounded up: a window that is not a whole number of blocks gets the next one
+#define VIB_WINDOW_BLOCKS ((CONFIG_SENSOR_VIB_STATS_WINDOW_MS + VIB_BLOCK_MS - 1) / VIB_BLOCK_MS)
+
+typedef struct
+{
+    float n;
+    float mean, m2, m3, m4;
+    float min, max;
+} vib_moments_t;
+
+typedef struct
+{
+    vib_moments_t current[VIB_AXES];
+    vib_moments_t blocks[VIB_WINDOW_BLOCKS][VIB_AXES];
+    int block_samples; // samples per block
+    int block_fill;    // samples in current
+    int block_pos;     // next slot in blocks
+    int blocks_valid;
+    int blocks_since_tumble;
+} vib_stats_t;
+
+/**
+ * @brief Reset the engine for the given input rate.
+ */
+void vib_stats_init(vib_stats_t *vs, int sample_rate_hz);
+
+/**
+ * @brief Add one sample (g per axis).
+ * @param sliding Written when a block closes
+ * @param tumbling Written when a tumbling window closes
+ * @return Bit 0 set if sliding was written, bit 1 set if tumbling was written
+ */
+int vib_stats_push(vib_stats_t *vs, const float accel[VIB_AXES], uint64_t timestamp_us,
+                   sensor_vibration_stats_t *sliding, sensor_vibration_stats_t *tumbling);
+
+#define VIB_STATS_SLIDING_READY 0x1
+#define VIB_STATS_TUMBLING_READY 0x2
+
+#endif // VIBRATION_STATS_H
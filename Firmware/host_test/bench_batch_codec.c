@@ -0,0 +1,265 @@
+// Size and CPU time per training batch (batch_codec.c) against the JSON
+// array the training topic used to publish. The JSON baseline reproduces
+// what the removed cJSON path did, since cJSON itself is not built for the
+// host: one object per sample and an item plus a key copy per field (13
+// allocations per sample), numbers printed the way cJSON prints them, into a
+// buffer grown by doubling. Before timing, the encoder is checked on the
+// cases a plain column cannot carry as-is: NAN, negative full scale and a
+// batch spanning more than 65535 sequence numbers.
+//
+//   bench_batch_codec [iterations]
+
+#include "batch_codec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PERIOD_US 1000
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Fridge at rest with the compressor running: gravity on z, a 50 Hz motor
+// vibration plus sensor noise, a slowly varying current and temperature
+static void make_batch(synchronized_sample_t *b, int count, uint32_t seq0)
+{
+    unsigned rng = 12345;
+    for (int i = 0; i < count; i++)
+    {
+        float t = i * (PERIOD_US * 1e-6f);
+        float vib = 0.02f * sinf(2.0f * (float)M_PI * 50.0f * t);
+        rng = rng * 1103515245u + 12345u;
+        float noise = (((rng >> 16) & 0xFF) - 127.5f) * (4.0f / MPU_ACCEL_LSB_PER_G);
+
+        memset(&b[i], 0, sizeof(b[i]));
+        b[i].seq = seq0 + (uint32_t)i;
+        b[i].timestamp_us = 1000000000ull + (uint64_t)b[i].seq * PERIOD_US;
+        b[i].accel_x_g = 0.01f + vib + noise;
+        b[i].accel_y_g = -0.02f + 0.5f * vib - noise;
+        b[i].accel_z_g = 1.0f + 0.2f * vib + 0.5f * noise;
+        b[i].latest_current_a = 1.2f + 0.05f * sinf(2.0f * (float)M_PI * 0.5f * t);
+        b[i].latest_temperature_c = 4.5f + 0.001f * i;
+        b[i].magnitude = sqrtf(b[i].accel_x_g * b[i].accel_x_g + b[i].accel_y_g * b[i].accel_y_g +
+                               b[i].accel_z_g * b[i].accel_z_g);
+    }
+}
+
+// ----- cJSON-style baseline -----
+typedef struct node
+{
+    struct node *next;
+    struct node *child;
+    char *key;
+    double value;
+} node_t;
+
+typedef struct
+{
+    char *buf;
+    size_t len, cap;
+} out_t;
+
+static node_t *new_number(node_t *obj, const char *key, double value, node_t **tail)
+{
+    node_t *n = calloc(1, sizeof(*n));
+    n->key = strdup(key);
+    n->value = value;
+    if (*tail)
+        (*tail)->next = n;
+    else
+        obj->child = n;
+    *tail = n;
+    return n;
+}
+
+static void out_reserve(out_t *o, size_t more)
+{
+    if (o->len + more < o->cap)
+        return;
+    while (o->len + more >= o->cap)
+        o->cap = o->cap ? o->cap * 2 : 256;
+    o->buf = realloc(o->buf, o->cap);
+}
+
+static void out_str(out_t *o, const char *s)
+{
+    size_t n = strlen(s);
+    out_reserve(o, n);
+    memcpy(o->buf + o->len, s, n + 1);
+    o->len += n;
+}
+
+// cJSON's print_number: null for non-finite, %d for integers, else the
+// shortest of %1.15g and %1.17g that reads back exactly
+static void out_number(out_t *o, double d)
+{
+    char num[32];
+    if (isnan(d) || isinf(d))
+        strcpy(num, "null");
+    else if (d == (double)(int)d)
+        snprintf(num, sizeof(num), "%d", (int)d);
+    else
+    {
+        snprintf(num, sizeof(num), "%1.15g", d);
+        if (strtod(num, NULL) != d)
+            snprintf(num, sizeof(num), "%1.17g", d);
+    }
+    out_str(o, num);
+}
+
+static size_t encode_json(const synchronized_sample_t *b, int count, char **json)
+{
+    node_t root = {0}, *last_obj = NULL;
+    for (int i = 0; i < count; i++)
+    {
+        node_t *obj = calloc(1, sizeof(*obj)), *tail = NULL;
+        new_number(obj, "t", (double)b[i].timestamp_us, &tail);
+        new_number(obj, "ax", b[i].accel_x_g, &tail);
+        new_number(obj, "ay", b[i].accel_y_g, &tail);
+        new_number(obj, "az", b[i].accel_z_g, &tail);
+        new_number(obj, "I", b[i].latest_current_a, &tail);
+        new_number(obj, "T", b[i].latest_temperature_c, &tail);
+        if (last_obj)
+            last_obj->next = obj;
+        else
+            root.child = obj;
+        last_obj = obj;
+    }
+
+    out_t o = {0};
+    out_str(&o, "[");
+    for (node_t *obj = root.child; obj; obj = obj->next)
+    {
+        out_str(&o, obj == root.child ? "{" : ",{");
+        for (node_t *n = obj->child; n; n = n->next)
+        {
+            out_str(&o, n == obj->child ? "\"" : ",\"");
+            out_str(&o, n->key);
+            out_str(&o, "\":");
+            out_number(&o, n->value);
+        }
+        out_str(&o, "}");
+    }
+    out_str(&o, "]");
+
+    for (node_t *obj = root.child, *next_obj; obj; obj = next_obj)
+    {
+        next_obj = obj->next;
+        for (node_t *n = obj->child, *next; n; n = next)
+        {
+            next = n->next;
+            free(n->key);
+            free(n);
+        }
+        free(obj);
+    }
+    *json = o.buf;
+    return o.len;
+}
+
+// ----- Checks -----
+static int16_t plain_value(const uint8_t *out, int count, int column, int i)
+{
+    int channels = __builtin_popcount(((const batch_codec_header_t *)out)->channels);
+    int16_t v;
+    memcpy(&v, out + sizeof(batch_codec_header_t) + channels * sizeof(float) +
+                    ((size_t)column * count + i) * sizeof(int16_t),
+           sizeof(v));
+    return v;
+}
+
+static int check_edge_cases(synchronized_sample_t *b, int count, uint8_t *out, size_t out_size)
+{
+    int fail = 0;
+    make_batch(b, count, 100);
+    b[10].latest_current_a = NAN;
+    b[11].accel_x_g = -2.0f;
+    b[12].accel_x_g = NAN;
+    size_t len = batch_codec_encode(b, count, BATCH_ENCODING_PLAIN, out, out_size);
+    if (!len || plain_value(out, count, 3, 10) != BATCH_CODEC_NAN || plain_value(out, count, 0, 12) != BATCH_CODEC_NAN ||
+        plain_value(out, count, 0, 11) != BATCH_CODEC_NAN + 1 || plain_value(out, count, 3, 11) == BATCH_CODEC_NAN)
+    {
+        printf("FAIL: NAN / full-scale values not encoded as expected\n");
+        fail = 1;
+    }
+
+    // Lost samples across a long outage: the seq column must widen
+    make_batch(b, count, 100);
+    for (int i = count / 2; i < count; i++)
+    {
+        b[i].seq += 70000;
+        b[i].timestamp_us += 70000ull * PERIOD_US;
+    }
+    len = batch_codec_encode(b, count, BATCH_ENCODING_PLAIN, out, out_size);
+    const batch_codec_header_t *hdr = (const batch_codec_header_t *)out;
+    uint32_t last = 0;
+    if (len)
+        memcpy(&last, out + len - sizeof(last), sizeof(last));
+    if (!len || len > batch_codec_max_size(count) || hdr->flags != (BATCH_FLAG_SEQ | BATCH_FLAG_SEQ32) ||
+        last != b[count - 1].seq - b[0].seq)
+    {
+        printf("FAIL: seq column for a batch spanning %u seqs\n", b[count - 1].seq - b[0].seq);
+        fail = 1;
+    }
+    len = batch_codec_encode(b, count, BATCH_ENCODING_COMPRESSED, out, out_size);
+    if (!len || (((const batch_codec_header_t *)out)->flags & BATCH_FLAG_SEQ32))
+    {
+        printf("FAIL: compressed batch spanning %u seqs\n", b[count - 1].seq - b[0].seq);
+        fail = 1;
+    }
+    return fail;
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 200;
+    const int count = BATCH_SIZE;
+    static synchronized_sample_t batch[BATCH_SIZE];
+    size_t out_size = batch_codec_max_size(count);
+    uint8_t *out = malloc(out_size);
+
+    int fail = check_edge_cases(batch, count, out, out_size);
+
+    make_batch(batch, count, 100);
+    size_t sizes[3] = {0};
+    double times[3] = {0};
+    for (int v = 0; v < 3; v++)
+    {
+        double start = now_s();
+        for (int it = 0; it < iterations; it++)
+        {
+            if (v < 2)
+            {
+                sizes[v] = batch_codec_encode(batch, count, v == 0 ? BATCH_ENCODING_PLAIN : BATCH_ENCODING_COMPRESSED,
+                                              out, out_size);
+            }
+            else
+            {
+                char *json;
+                sizes[v] = encode_json(batch, count, &json);
+                free(json);
+            }
+        }
+        times[v] = (now_s() - start) / iterations;
+    }
+
+    static const char *names[] = {"binary plain", "binary compressed", "json (cJSON-style)"};
+    printf("%d samples per batch, %d iterations\n", count, iterations);
+    for (int v = 0; v < 3; v++)
+        printf("%-20s %7zu bytes (%5.2f B/sample)  %8.1f us/batch  %6.1fx json size\n", names[v], sizes[v],
+               (double)sizes[v] / count, times[v] * 1e6, (double)sizes[2] / sizes[v]);
+
+    if (!sizes[0] || !sizes[1] || sizes[1] > sizes[0])
+    {
+        printf("FAIL: encoding\n");
+        fail = 1;
+    }
+    free(out);
+    printf(fail ? "FAIL\n" : "PASS\n");
+    return fail;
+}
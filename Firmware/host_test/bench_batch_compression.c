@@ -0,0 +1,281 @@
+// Compression ratio and throughput of the compressed training batch encoding
+// (batch_codec.c) against plain columns, on synthetic traces for the states
+// a fridge goes through, or on a recorded trace: the CSV that
+// tools/decode_batch.py writes for captured batches. Every compressed batch
+// is decoded again and must reproduce the plain columns, sequence numbers
+// and timestamps exactly.
+//
+//   bench_batch_compression [iterations] [trace.csv]
+
+#include "batch_codec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_BATCHES 64
+
+typedef struct
+{
+    const char *name;
+    synchronized_sample_t *samples;
+    int count;
+} trace_t;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static float noise(unsigned *rng, float lsb)
+{
+    *rng = *rng * 1103515245u + 12345u;
+    return (((*rng >> 16) & 0xFF) - 127.5f) / 32.0f * lsb;
+}
+
+typedef enum
+{
+    TRACE_IDLE,      // compressor off: gravity and sensor noise
+    TRACE_RUNNING,   // 50 Hz compressor vibration, current ripple
+    TRACE_DOOR,      // door slams: decaying impacts
+    TRACE_GAPS,      // running, with lost samples and clock corrections
+} trace_kind_t;
+
+static void make_trace(trace_kind_t kind, synchronized_sample_t *s, int count)
+{
+    const float lsb = 1.0f / MPU_ACCEL_LSB_PER_G;
+    unsigned rng = 1 + kind;
+    uint32_t seq = 1000;
+    uint64_t t_us = 5000000000ull;
+    for (int i = 0; i < count; i++)
+    {
+        float t = i * 1e-3f;
+        bool running = kind != TRACE_IDLE;
+        float vib = running ? 0.02f * sinf(2.0f * (float)M_PI * 50.0f * t) + 0.005f * sinf(2.0f * (float)M_PI * 100.0f * t)
+                            : 0.0f;
+        float impact = 0.0f;
+        if (kind == TRACE_DOOR)
+        {
+            float since = fmodf(t, 7.3f);
+            impact = 0.8f * expf(-since * 25.0f) * sinf(2.0f * (float)M_PI * 35.0f * since);
+        }
+
+        if (kind == TRACE_GAPS && i % 2500 == 1200)
+        {
+            seq += 40; // overflow: lost frames
+            t_us += 40000;
+        }
+        int jitter = kind == TRACE_GAPS && i % 997 == 0 ? 3 : 0; // clock resync step
+
+        memset(&s[i], 0, sizeof(s[i]));
+        s[i].seq = seq++;
+        s[i].timestamp_us = t_us + jitter;
+        t_us += 1000;
+        s[i].accel_x_g = 0.01f + vib + impact + noise(&rng, 4 * lsb);
+        s[i].accel_y_g = -0.02f + 0.5f * vib + 0.3f * impact + noise(&rng, 4 * lsb);
+        s[i].accel_z_g = 1.0f + 0.2f * vib - 0.5f * impact + noise(&rng, 4 * lsb);
+        s[i].latest_current_a = running ? 1.2f + 0.05f * sinf(2.0f * (float)M_PI * 0.5f * t) : 0.002f;
+        s[i].latest_temperature_c = 4.5f + 0.0001f * i;
+    }
+}
+
+// Columns of tools/decode_batch.py: seq,t,ax,ay,az[,gx,gy,gz][,Td],I,T
+static int load_csv(const char *path, synchronized_sample_t *s, int max)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return -1;
+    char line[512];
+    int n = 0;
+    if (!fgets(line, sizeof(line), f)) // header
+        n = -1;
+    while (n >= 0 && n < max && fgets(line, sizeof(line), f))
+    {
+        double v[12];
+        int k = 0;
+        for (char *p = line, *end; k < 12; p = end + 1)
+        {
+            v[k++] = strtod(p, &end);
+            if (*end != ',')
+                break;
+        }
+        if (k < 7)
+            continue;
+        memset(&s[n], 0, sizeof(s[n]));
+        s[n].seq = (uint32_t)v[0];
+        s[n].timestamp_us = (uint64_t)v[1];
+        s[n].accel_x_g = (float)v[2];
+        s[n].accel_y_g = (float)v[3];
+        s[n].accel_z_g = (float)v[4];
+        s[n].latest_current_a = (float)v[k - 2];
+        s[n].latest_temperature_c = (float)v[k - 1];
+        n++;
+    }
+    fclose(f);
+    return n;
+}
+
+// ----- Decoder for the round trip (same as tools/decode_batch.py) -----
+typedef struct
+{
+    const uint8_t *p, *end;
+    uint64_t acc;
+    int bits;
+    bool error;
+} bit_reader_t;
+
+static uint32_t bits_get(bit_reader_t *br, int n)
+{
+    while (br->bits < n)
+    {
+        if (br->p == br->end)
+        {
+            br->error = true;
+            return 0;
+        }
+        br->acc = (br->acc << 8) | *br->p++;
+        br->bits += 8;
+    }
+    br->bits -= n;
+    return (uint32_t)(br->acc >> br->bits) & (uint32_t)((1ull << n) - 1);
+}
+
+static uint32_t get_code(bit_reader_t *br)
+{
+    static const int widths[] = {3, 8, 13};
+    if (!bits_get(br, 1))
+        return 0;
+    for (int i = 0; i < 3; i++)
+        if (!bits_get(br, 1))
+            return bits_get(br, widths[i]);
+    return bits_get(br, 32);
+}
+
+static int32_t unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// Compare a compressed batch with the plain encoding of the same samples
+static bool round_trip_ok(const uint8_t *comp, size_t comp_len, const uint8_t *plain,
+                          const synchronized_sample_t *s, int count)
+{
+    batch_codec_header_t hdr;
+    memcpy(&hdr, comp, sizeof(hdr));
+    if (!(hdr.flags & BATCH_FLAG_COMPRESSED))
+        return true; // fell back to plain
+    int channels = __builtin_popcount(hdr.channels);
+    size_t head = sizeof(hdr) + channels * sizeof(float);
+    bit_reader_t br = {.p = comp + head, .end = comp + comp_len};
+
+    uint64_t t = hdr.start_us;
+    int64_t delta = 0;
+    for (int i = 1; i < count; i++)
+    {
+        delta += unzigzag(get_code(&br));
+        t += (uint64_t)delta;
+        if (t != s[i].timestamp_us)
+            return false;
+    }
+    uint32_t seq = hdr.first_seq;
+    for (int i = 1; i < count; i++)
+    {
+        seq += 1 + ((hdr.flags & BATCH_FLAG_SEQ) ? get_code(&br) : 0);
+        if (seq != s[i].seq)
+            return false;
+    }
+    for (int c = 0; c < channels; c++)
+    {
+        const uint8_t *col = plain + head + (size_t)c * count * sizeof(int16_t);
+        int16_t v = (int16_t)bits_get(&br, 16);
+        for (int i = 0; i < count; i++)
+        {
+            if (i > 0)
+                v = (int16_t)(v + unzigzag(get_code(&br)));
+            int16_t ref;
+            memcpy(&ref, col + i * sizeof(int16_t), sizeof(ref));
+            if (v != ref)
+                return false;
+        }
+    }
+    return !br.error;
+}
+
+static int run(const trace_t *tr, int iterations, uint8_t *plain, uint8_t *comp, size_t out_size)
+{
+    int batches = tr->count / BATCH_SIZE;
+    size_t plain_bytes = 0, comp_bytes = 0;
+    int compressed = 0, fail = 0;
+
+    for (int b = 0; b < batches; b++)
+    {
+        const synchronized_sample_t *s = tr->samples + (size_t)b * BATCH_SIZE;
+        size_t pl = batch_codec_encode(s, BATCH_SIZE, BATCH_ENCODING_PLAIN, plain, out_size);
+        size_t cl = batch_codec_encode(s, BATCH_SIZE, BATCH_ENCODING_COMPRESSED, comp, out_size);
+        if (!pl || !cl || cl > pl || !round_trip_ok(comp, cl, plain, s, BATCH_SIZE))
+        {
+            printf("FAIL: %s batch %d does not round-trip\n", tr->name, b);
+            fail = 1;
+        }
+        plain_bytes += pl;
+        comp_bytes += cl;
+        compressed += (comp[3] & BATCH_FLAG_COMPRESSED) != 0;
+    }
+
+    double times[2];
+    for (int e = 0; e < 2; e++)
+    {
+        double start = now_s();
+        for (int it = 0; it < iterations; it++)
+            for (int b = 0; b < batches; b++)
+                batch_codec_encode(tr->samples + (size_t)b * BATCH_SIZE, BATCH_SIZE, (batch_encoding_t)e, comp,
+                                   out_size);
+        times[e] = (now_s() - start) / ((double)iterations * batches);
+    }
+
+    printf("%-10s %3d batches  plain %6.2f B/sample  compressed %5.2f B/sample (%4.2fx, %d/%d bit-packed)  "
+           "encode %5.1f / %5.1f us/batch (%5.1f / %4.1f M samples/s)\n",
+           tr->name, batches, (double)plain_bytes / (batches * BATCH_SIZE),
+           (double)comp_bytes / (batches * BATCH_SIZE), (double)plain_bytes / comp_bytes, compressed, batches,
+           times[0] * 1e6, times[1] * 1e6, BATCH_SIZE / times[0] * 1e-6, BATCH_SIZE / times[1] * 1e-6);
+    return fail;
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 50;
+    const int per_trace = 10 * BATCH_SIZE;
+    static synchronized_sample_t samples[MAX_BATCHES * BATCH_SIZE];
+    size_t out_size = batch_codec_max_size(BATCH_SIZE);
+    uint8_t *plain = malloc(out_size), *comp = malloc(out_size);
+    int fail = 0;
+
+    if (argc > 2)
+    {
+        int n = load_csv(argv[2], samples, MAX_BATCHES * BATCH_SIZE);
+        if (n < BATCH_SIZE)
+        {
+            printf("%s: need at least %d samples\n", argv[2], BATCH_SIZE);
+            return 1;
+        }
+        trace_t tr = {argv[2], samples, n};
+        fail |= run(&tr, iterations, plain, comp, out_size);
+    }
+    else
+    {
+        static const char *names[] = {"idle", "running", "door", "gaps"};
+        for (int k = TRACE_IDLE; k <= TRACE_GAPS; k++)
+        {
+            make_trace((trace_kind_t)k, samples, per_trace);
+            trace_t tr = {names[k], samples, per_trace};
+            fail |= run(&tr, iterations, plain, comp, out_size);
+        }
+    }
+
+    free(plain);
+    free(comp);
+    printf(fail ? "FAIL\n" : "PASS\n");
+    return fail;
+}
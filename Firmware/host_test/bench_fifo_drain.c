@@ -0,0 +1,134 @@
+// Bus model of the MPU6050 FIFO drain (mpu_drain_fifo in sensor_manager.c),
+// comparing one transaction per frame, as the driver used to read the FIFO,
+// with burst reads of up to CONFIG_MPU6050_FIFO_BURST_MAX_FRAMES frames. Each
+// wakeup reads FIFO_COUNT, then the frames it reports; wakeups that arrive
+// while a drain is running coalesce, as mpu_sem does. Bus timing is that of
+// model_i2c_contention.c with the MPU alone on the bus. For each scenario
+// the model reports transactions/s, bytes/s on the wire and of FIFO data,
+// bus occupancy and the samples lost to FIFO overflows.
+//
+//   bench_fifo_drain [simulated seconds]
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SCL_HZ 400000
+#define TXN_OVERHEAD_US 25.0 // driver setup and ISR per transaction
+#define MPU_FIFO_SIZE 1024
+#define BURST_MAX_FRAMES 64 // CONFIG_MPU6050_FIFO_BURST_MAX_FRAMES default
+
+typedef struct
+{
+    const char *name;
+    int rate_hz;
+    int frame_size;   // 6, 12 or 14 bytes
+    int wake_samples; // 1 = DATA_RDY, N = watermark timer
+} scenario_t;
+
+typedef struct
+{
+    uint64_t txns, wire_bytes, fifo_bytes, samples, lost;
+    uint32_t overflows;
+    double bus_us;
+} drain_stats_t;
+
+static double xfer_us(int tx, int rx)
+{
+    // Address byte per phase, 9 clocks per byte, plus start/stop
+    int bytes = (tx ? 1 + tx : 0) + (rx ? 1 + rx : 0);
+    return (bytes * 9 + 2) * 1e6 / SCL_HZ + TXN_OVERHEAD_US;
+}
+
+// One register read (or write, rx = 0) on the bus; returns its end time
+static double txn(drain_stats_t *st, double now, int tx, int rx)
+{
+    double us = xfer_us(tx, rx);
+    st->txns++;
+    st->wire_bytes += (tx ? 1 + tx : 0) + (rx ? 1 + rx : 0);
+    st->bus_us += us;
+    return now + us;
+}
+
+static void run(const scenario_t *sc, int burst_frames, double seconds, drain_stats_t *st)
+{
+    const double period_us = sc->wake_samples * 1e6 / sc->rate_hz;
+    const double end = seconds * 1e6;
+    uint64_t base = 0, consumed = 0; // samples dropped by FIFO resets, samples read
+    double now = 0, wake = period_us;
+
+    *st = (drain_stats_t){0};
+    while (wake < end)
+    {
+        // A wakeup given during the previous drain starts the next one at once
+        double start = fmax(now, wake);
+        wake = (floor(start / period_us) + 1) * period_us;
+
+        now = txn(st, start, 1, 2); // FIFO_COUNTH/L
+        uint64_t avail = (uint64_t)(now * sc->rate_hz / 1e6) - base - consumed;
+        if (avail * sc->frame_size > MPU_FIFO_SIZE)
+        {
+            // Overflowed: the driver resets the FIFO and starts over
+            st->overflows++;
+            st->lost += avail;
+            now = txn(st, now, 2, 0);
+            base = (uint64_t)(now * sc->rate_hz / 1e6) - consumed;
+            continue;
+        }
+        while (avail > 0)
+        {
+            int n = avail < (uint64_t)burst_frames ? (int)avail : burst_frames;
+            now = txn(st, now, 1, n * sc->frame_size); // FIFO_R_W
+            st->fifo_bytes += (uint64_t)n * sc->frame_size;
+            consumed += n;
+            avail -= n;
+        }
+    }
+    st->samples = consumed;
+}
+
+static void print_row(const char *mode, const drain_stats_t *st, double seconds)
+{
+    printf("  %-10s %7.0f txn/s  wire %7.0f B/s  fifo %6.0f B/s  bus %5.1f%%  %.2f txn/sample  lost %llu\n", mode,
+           st->txns / seconds, st->wire_bytes / seconds, st->fifo_bytes / seconds, 100.0 * st->bus_us / (seconds * 1e6),
+           st->samples ? (double)st->txns / st->samples : 0.0, (unsigned long long)st->lost);
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 60.0;
+    const scenario_t scenarios[] = {
+        {"1 kHz, 6 B, DATA_RDY", 1000, 6, 1},
+        {"1 kHz, 6 B, watermark 10", 1000, 6, 10},
+        {"1 kHz, 14 B, watermark 50", 1000, 14, 50},
+        {"4 kHz, 6 B, DATA_RDY", 4000, 6, 1},
+        {"4 kHz, 6 B, watermark 40", 4000, 6, 40},
+    };
+
+    int fail = 0;
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+    {
+        const scenario_t *sc = &scenarios[i];
+        int burst = MPU_FIFO_SIZE / sc->frame_size < BURST_MAX_FRAMES ? MPU_FIFO_SIZE / sc->frame_size : BURST_MAX_FRAMES;
+        drain_stats_t single, bursts;
+        run(sc, 1, seconds, &single);
+        run(sc, burst, seconds, &bursts);
+
+        printf("%s (%.0f s)\n", sc->name, seconds);
+        print_row("per-sample", &single, seconds);
+        print_row("burst", &bursts, seconds);
+
+        // Bursts must keep up with the FIFO and never need more transactions
+        double expected = (double)sc->rate_hz * sc->frame_size;
+        bool ok = bursts.lost == 0 && bursts.txns <= single.txns && bursts.fifo_bytes / seconds > 0.99 * expected;
+        if (!ok)
+        {
+            printf("FAIL: %s\n", sc->name);
+            fail = 1;
+        }
+    }
+    printf(fail ? "FAIL\n" : "PASS\n");
+    return fail;
+}
@@ -0,0 +1,231 @@
+// Messages per second for the streaming JSON writer (json_writer.c) against
+// the snprintf("%f") formatting it replaced, on the preview sample and the
+// vibration statistics payloads, single-threaded (one core). Before timing,
+// every writer message is checked against snprintf for random values: same
+// numbers to within the last decimal, null for non-finite values, and the
+// overflow flag set when the buffer is too small.
+//
+//   bench_json_writer [messages per variant]
+
+#include "json_writer.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PAYLOAD_MAX 256
+
+typedef struct
+{
+    uint64_t t;
+    float ax, ay, az, current, temperature;
+} sample_t;
+
+typedef struct
+{
+    uint64_t t;
+    uint32_t ms;
+    float axis[3][5]; // rms, peak, crest, skewness, kurtosis
+} vib_t;
+
+static const int vib_decimals[5] = {4, 4, 2, 2, 2};
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static float frand(unsigned *rng, float range)
+{
+    *rng = *rng * 1103515245u + 12345u;
+    return ((*rng >> 8) & 0xFFFF) / 65535.0f * 2.0f * range - range;
+}
+
+static void make_sample(unsigned *rng, sample_t *s)
+{
+    s->t = 1700000000000000ull + (*rng % 1000000);
+    s->ax = frand(rng, 2.0f);
+    s->ay = frand(rng, 2.0f);
+    s->az = 1.0f + frand(rng, 1.0f);
+    s->current = 1.2f + frand(rng, 0.5f);
+    s->temperature = 4.5f + frand(rng, 10.0f);
+}
+
+static void make_vib(unsigned *rng, vib_t *v)
+{
+    v->t = 1700000000000000ull + (*rng % 1000000);
+    v->ms = 1000;
+    for (int a = 0; a < 3; a++)
+        for (int k = 0; k < 5; k++)
+            v->axis[a][k] = fabsf(frand(rng, k < 2 ? 0.5f : 20.0f));
+}
+
+// ----- Streaming writer, as data_publisher builds these topics -----
+static const char *writer_sample(const sample_t *s, char *buf, size_t size)
+{
+    json_writer_t w;
+    json_writer_init(&w, buf, size);
+    json_object_begin(&w);
+    json_kv_uint(&w, "t", s->t);
+    json_kv_float(&w, "ax", s->ax, 3);
+    json_kv_float(&w, "ay", s->ay, 3);
+    json_kv_float(&w, "az", s->az, 3);
+    json_kv_float(&w, "I", s->current, 3);
+    json_kv_float(&w, "T", s->temperature, 2);
+    json_object_end(&w);
+    return json_writer_finish(&w);
+}
+
+static const char *writer_vib(const vib_t *v, char *buf, size_t size)
+{
+    static const char *const names[3] = {"x", "y", "z"};
+    json_writer_t w;
+    json_writer_init(&w, buf, size);
+    json_object_begin(&w);
+    json_kv_uint(&w, "t", v->t);
+    json_kv_uint(&w, "ms", v->ms);
+    for (int a = 0; a < 3; a++)
+    {
+        json_key(&w, names[a]);
+        json_array_begin(&w);
+        for (int k = 0; k < 5; k++)
+            json_float(&w, v->axis[a][k], vib_decimals[k]);
+        json_array_end(&w);
+    }
+    json_object_end(&w);
+    return json_writer_finish(&w);
+}
+
+// ----- snprintf baseline, as the stream path used to format -----
+static const char *printf_sample(const sample_t *s, char *buf, size_t size)
+{
+    int n = snprintf(buf, size, "{\"t\":%llu,\"ax\":%.3f,\"ay\":%.3f,\"az\":%.3f,\"I\":%.3f,\"T\":%.2f}",
+                     (unsigned long long)s->t, s->ax, s->ay, s->az, s->current, s->temperature);
+    return n > 0 && (size_t)n < size ? buf : NULL;
+}
+
+static const char *printf_vib(const vib_t *v, char *buf, size_t size)
+{
+    int n = snprintf(buf, size, "{\"t\":%llu,\"ms\":%u", (unsigned long long)v->t, v->ms);
+    for (int a = 0; a < 3 && n > 0 && (size_t)n < size; a++)
+        n += snprintf(buf + n, size - n, ",\"%c\":[%.4f,%.4f,%.2f,%.2f,%.2f]", 'x' + a, v->axis[a][0],
+                      v->axis[a][1], v->axis[a][2], v->axis[a][3], v->axis[a][4]);
+    if (n > 0 && (size_t)n + 1 < size)
+        strcpy(buf + n, "}");
+    return n > 0 && (size_t)n + 1 < size ? buf : NULL;
+}
+
+// ----- Checks -----
+// Same keys and punctuation, numbers equal to within one unit of the last
+// decimal (the writer rounds the float, printf the exact binary value)
+static bool same_json(const char *a, const char *b)
+{
+    while (*a && *b)
+    {
+        bool num_a = (*a == '-' || (*a >= '0' && *a <= '9'));
+        bool num_b = (*b == '-' || (*b >= '0' && *b <= '9'));
+        if (num_a && num_b)
+        {
+            char *ea, *eb;
+            double va = strtod(a, &ea), vb = strtod(b, &eb);
+            const char *dot = memchr(b, '.', (size_t)(eb - b));
+            double ulp = dot ? pow(10.0, -(double)(eb - dot - 1)) : 1.0;
+            if (fabs(va - vb) > ulp * 1.001)
+                return false;
+            a = ea;
+            b = eb;
+            continue;
+        }
+        if (*a++ != *b++)
+            return false;
+    }
+    return *a == *b;
+}
+
+static int check(void)
+{
+    char w[PAYLOAD_MAX], p[PAYLOAD_MAX];
+    unsigned rng = 99;
+    int fail = 0;
+    for (int i = 0; i < 100000 && !fail; i++)
+    {
+        sample_t s;
+        vib_t v;
+        make_sample(&rng, &s);
+        make_vib(&rng, &v);
+        const char *ws = writer_sample(&s, w, sizeof(w));
+        if (!ws || !same_json(ws, printf_sample(&s, p, sizeof(p))))
+        {
+            printf("FAIL: sample\n  writer %s\n  printf %s\n", ws ? ws : "(overflow)", p);
+            fail = 1;
+        }
+        const char *wv = writer_vib(&v, w, sizeof(w));
+        if (!wv || !same_json(wv, printf_vib(&v, p, sizeof(p))))
+        {
+            printf("FAIL: vibration\n  writer %s\n  printf %s\n", wv ? wv : "(overflow)", p);
+            fail = 1;
+        }
+    }
+
+    sample_t s = {1, NAN, INFINITY, -0.0004f, 1.0f, 2.0f};
+    const char *ws = writer_sample(&s, w, sizeof(w));
+    if (!ws || strcmp(ws, "{\"t\":1,\"ax\":null,\"ay\":null,\"az\":0.000,\"I\":1.000,\"T\":2.00}") != 0)
+    {
+        printf("FAIL: non-finite values: %s\n", ws ? ws : "(overflow)");
+        fail = 1;
+    }
+    make_sample(&rng, &s);
+    size_t len = strlen(writer_sample(&s, w, sizeof(w)));
+    if (writer_sample(&s, w, len) != NULL || writer_sample(&s, w, len + 1) == NULL)
+    {
+        printf("FAIL: overflow flag at %zu bytes\n", len);
+        fail = 1;
+    }
+    return fail;
+}
+
+typedef const char *(*format_fn)(const void *msg, char *buf, size_t size);
+
+static double bench(const char *name, format_fn fn, const void *msgs, size_t msg_size, int pool, int count)
+{
+    char buf[PAYLOAD_MAX];
+    size_t bytes = 0;
+    double start = now_s();
+    for (int i = 0; i < count; i++)
+    {
+        const char *out = fn((const uint8_t *)msgs + (size_t)(i % pool) * msg_size, buf, sizeof(buf));
+        bytes += out ? strlen(out) : 0;
+    }
+    double rate = count / (now_s() - start);
+    printf("%-20s %9.0f msg/s  %5.0f ns/msg  %5.1f B/msg\n", name, rate, 1e9 / rate, (double)bytes / count);
+    return rate;
+}
+
+int main(int argc, char **argv)
+{
+    int count = argc > 1 ? atoi(argv[1]) : 2000000;
+    int fail = check();
+
+    enum { POOL = 1024 };
+    static sample_t samples[POOL];
+    static vib_t vibs[POOL];
+    unsigned rng = 7;
+    for (int i = 0; i < POOL; i++)
+    {
+        make_sample(&rng, &samples[i]);
+        make_vib(&rng, &vibs[i]);
+    }
+
+    printf("%d messages each, one thread\n", count);
+    double ws = bench("sample, writer", (format_fn)writer_sample, samples, sizeof(sample_t), POOL, count);
+    double ps = bench("sample, snprintf", (format_fn)printf_sample, samples, sizeof(sample_t), POOL, count);
+    double wv = bench("vibration, writer", (format_fn)writer_vib, vibs, sizeof(vib_t), POOL, count);
+    double pv = bench("vibration, snprintf", (format_fn)printf_vib, vibs, sizeof(vib_t), POOL, count);
+    printf("writer speedup: sample %.1fx, vibration %.1fx\n", ws / ps, wv / pv);
+
+    printf(fail ? "FAIL\n" : "PASS\n");
+    return fail;
+}
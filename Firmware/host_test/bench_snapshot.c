@@ -0,0 +1,194 @@
+// Reader latency of the latest-value snapshot cells (snapshot.c) against the
+// mutex-protected copy they replaced. One writer publishes a value about the
+// size of the vibration statistics as fast as it can while reader threads
+// time every read.
+// With fewer cores than threads the writer is regularly preempted mid-update,
+// which is where a mutex reader stalls and a snapshot reader does not. The
+// max also includes readers preempted while timing. Every value read must be
+// consistent.
+//
+//   bench_snapshot [seconds per variant] [reader threads]
+
+#include "snapshot.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FIELDS 16
+#define MAX_READERS 8
+#define HIST_BUCKETS 64 // log2 nanoseconds
+
+typedef struct
+{
+    uint32_t count;
+    float values[FIELDS];
+} value_t;
+
+typedef struct
+{
+    uint64_t reads, torn, failed;
+    uint64_t hist[HIST_BUCKETS];
+    uint64_t max_ns;
+} reader_stats_t;
+
+static SNAPSHOT_CELL(value_t) cell;
+static value_t locked_value;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static bool use_mutex;
+static atomic_bool stop;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void make_value(uint32_t count, value_t *v)
+{
+    v->count = count;
+    for (int i = 0; i < FIELDS; i++)
+        v->values[i] = (float)((count + (uint32_t)i) & 0xFFFFF);
+}
+
+static bool value_intact(const value_t *v)
+{
+    value_t ref;
+    make_value(v->count, &ref);
+    return memcmp(v, &ref, sizeof(ref)) == 0;
+}
+
+static void *writer(void *arg)
+{
+    (void)arg;
+    value_t v;
+    for (uint32_t count = 1; !atomic_load(&stop); count++)
+    {
+        make_value(count, &v);
+        if (use_mutex)
+        {
+            pthread_mutex_lock(&lock);
+            locked_value = v;
+            pthread_mutex_unlock(&lock);
+        }
+        else
+        {
+            SNAPSHOT_WRITE(&cell, &v);
+        }
+    }
+    return NULL;
+}
+
+static void *reader(void *arg)
+{
+    reader_stats_t *st = arg;
+    value_t v;
+    while (!atomic_load(&stop))
+    {
+        uint64_t t0 = now_ns();
+        bool ok;
+        if (use_mutex)
+        {
+            pthread_mutex_lock(&lock);
+            v = locked_value;
+            pthread_mutex_unlock(&lock);
+            ok = true;
+        }
+        else
+        {
+            ok = SNAPSHOT_READ(&cell, &v);
+        }
+        uint64_t ns = now_ns() - t0;
+
+        st->reads++;
+        if (!ok)
+            st->failed++;
+        else if (!value_intact(&v))
+            st->torn++;
+        int b = 0;
+        while (b < HIST_BUCKETS - 1 && (1ull << (b + 1)) <= ns)
+            b++;
+        st->hist[b]++;
+        if (ns > st->max_ns)
+            st->max_ns = ns;
+        if ((st->reads & 255) == 0)
+            sched_yield(); // let the writer in on a single core
+    }
+    return NULL;
+}
+
+// Upper bound of the bucket holding the given fraction of reads
+static uint64_t percentile_ns(const reader_stats_t *st, double fraction)
+{
+    uint64_t target = (uint64_t)(st->reads * fraction), seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; b++)
+    {
+        seen += st->hist[b];
+        if (seen > target)
+            return 2ull << b;
+    }
+    return st->max_ns;
+}
+
+static bool run(bool mutex, double seconds, int readers, reader_stats_t *total)
+{
+    use_mutex = mutex;
+    atomic_store(&stop, false);
+    memset(&cell, 0, sizeof(cell));
+
+    // Publish one value first so no reader starts on an empty cell
+    value_t first;
+    make_value(0, &first);
+    SNAPSHOT_WRITE(&cell, &first);
+    locked_value = first;
+
+    reader_stats_t st[MAX_READERS] = {0};
+    pthread_t wtid, rtid[MAX_READERS];
+    pthread_create(&wtid, NULL, writer, NULL);
+    for (int i = 0; i < readers; i++)
+        pthread_create(&rtid[i], NULL, reader, &st[i]);
+
+    struct timespec ts = {(time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9)};
+    nanosleep(&ts, NULL);
+    atomic_store(&stop, true);
+    pthread_join(wtid, NULL);
+
+    memset(total, 0, sizeof(*total));
+    for (int i = 0; i < readers; i++)
+    {
+        pthread_join(rtid[i], NULL);
+        total->reads += st[i].reads;
+        total->torn += st[i].torn;
+        total->failed += st[i].failed;
+        for (int b = 0; b < HIST_BUCKETS; b++)
+            total->hist[b] += st[i].hist[b];
+        if (st[i].max_ns > total->max_ns)
+            total->max_ns = st[i].max_ns;
+    }
+
+    printf("%-8s %10llu reads (%5.1f M/s) p50 < %5llu ns  p99 < %6llu ns  p99.99 < %8llu ns  max %9llu ns  torn %llu\n",
+           mutex ? "mutex" : "snapshot", (unsigned long long)total->reads, total->reads / seconds * 1e-6,
+           (unsigned long long)percentile_ns(total, 0.5), (unsigned long long)percentile_ns(total, 0.99),
+           (unsigned long long)percentile_ns(total, 0.9999), (unsigned long long)total->max_ns,
+           (unsigned long long)total->torn);
+    return total->torn == 0 && total->failed == 0;
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 3.0;
+    int readers = argc > 2 ? atoi(argv[2]) : 2;
+    if (readers < 1 || readers > MAX_READERS)
+        readers = 2;
+
+    printf("%d reader thread(s), 1 writer, %zu-byte value, %.1f s each\n", readers, sizeof(value_t), seconds);
+    reader_stats_t snap, mutex;
+    int fail = !run(false, seconds, readers, &snap);
+    fail |= !run(true, seconds, readers, &mutex);
+    printf(fail ? "FAIL\n" : "PASS\n");
+    return fail;
+}
@@ -0,0 +1,402 @@
+// Discrete-event model of the shared sensor I2C bus (i2c_scheduler.c policy).
+// The MPU drain, INA226 polling and SHTC3 measurement cycle are replayed as
+// the transaction sequences sensor_manager issues, each client waiting for
+// its previous transaction like the real tasks do. The bus is arbitrated
+// either in submission order (what a plain mutex amounts to) or by device
+// priority, non-preemptively, as the scheduler does. For each scenario the
+// model reports how long MPU transactions wait for the bus and how full the
+// MPU FIFO gets.
+//
+//   model_i2c_contention [simulated seconds]
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SCL_HZ 400000
+#define TXN_OVERHEAD_US 25.0 // driver setup and ISR per transaction
+#define XFER_TIMEOUT_MS 20   // CONFIG_I2C_SCHED_XFER_TIMEOUT_MS default, on top of the transfer time
+
+#define MPU_RATE_HZ 1000
+#define MPU_FIFO_SIZE 1024
+#define INA_PERIOD_US (64 * 2 * 1100) // 64 averages x 1.1 ms bus + shunt
+#define SHTC_PERIOD_US 1000000
+#define SHTC_WAKEUP_US 240
+#define SHTC_MEASURE_US 12100
+
+typedef enum
+{
+    ARB_FIFO,
+    ARB_PRIORITY,
+} arb_t;
+
+typedef enum
+{
+    PRIO_HIGH = 0,
+    PRIO_NORMAL,
+    PRIO_LOW,
+} prio_t;
+
+typedef struct
+{
+    const char *name;
+    arb_t arb;
+    int frame_size;       // 6, 12 or 14 bytes
+    int burst_frames;     // CONFIG_MPU6050_FIFO_BURST_MAX_FRAMES
+    int wake_samples;     // 1 = DATA_RDY, N = watermark timer
+    bool shtc_stretch;    // SHTC3 read issued at once, clock stretched for the measurement
+    double stuck_hold_us; // a LOW device holding the bus this long every 2 s, 0 = none
+} scenario_t;
+
+typedef struct client client_t;
+typedef void (*client_fn)(client_t *c, double now);
+
+struct client
+{
+    const char *name;
+    prio_t prio;
+    double timer; // next timer event, INFINITY if none
+    client_fn on_timer, on_done;
+    int state;
+
+    // Outstanding transaction
+    bool queued;
+    double submit_us;
+    uint64_t order;
+    int tx, rx;
+    double hold_us; // bus held beyond the byte transfer (clock stretching)
+
+    // Statistics
+    uint64_t txns;
+    uint32_t aborted; // cut off by the transfer timeout
+    double wait_max_us, bus_max_us;
+};
+
+typedef struct
+{
+    const scenario_t *sc;
+    client_t clients[4];
+    int num_clients;
+    client_t *on_bus;
+    double bus_done_us;
+    double bus_busy_us;
+    uint64_t submit_order;
+
+    // MPU FIFO
+    uint64_t produced_base; // samples discarded by FIFO resets
+    uint64_t consumed;
+    int remaining;
+    bool wake_pending;
+    uint32_t overflows;
+    int fifo_peak_bytes;
+} model_t;
+
+static model_t m;
+
+static double xfer_us(int tx, int rx)
+{
+    // Address byte per phase, 9 clocks per byte, plus start/stop
+    int bytes = (tx ? 1 + tx : 0) + (rx ? 1 + rx : 0);
+    return (bytes * 9 + 2) * 1e6 / SCL_HZ + TXN_OVERHEAD_US;
+}
+
+static void submit(client_t *c, double now, int tx, int rx, double hold_us)
+{
+    c->queued = true;
+    c->submit_us = now;
+    c->order = m.submit_order++;
+    c->tx = tx;
+    c->rx = rx;
+    c->hold_us = hold_us;
+}
+
+static void bus_start_next(double now)
+{
+    client_t *best = NULL;
+    for (int i = 0; i < m.num_clients; i++)
+    {
+        client_t *c = &m.clients[i];
+        if (!c->queued)
+            continue;
+        if (!best || (m.sc->arb == ARB_PRIORITY && c->prio < best->prio) ||
+            ((m.sc->arb == ARB_FIFO || c->prio == best->prio) && c->order < best->order))
+            best = c;
+    }
+    if (!best)
+        return;
+
+    double wait = now - best->submit_us;
+    double bus = xfer_us(best->tx, best->rx) + best->hold_us;
+    double timeout = XFER_TIMEOUT_MS * 1000.0 + xfer_us(best->tx, best->rx) - TXN_OVERHEAD_US;
+    if (bus > timeout)
+    {
+        // The driver gives up and frees the bus
+        bus = timeout;
+        best->aborted++;
+    }
+    best->queued = false;
+    best->txns++;
+    if (wait > best->wait_max_us)
+        best->wait_max_us = wait;
+    if (bus > best->bus_max_us)
+        best->bus_max_us = bus;
+    m.on_bus = best;
+    m.bus_done_us = now + bus;
+    m.bus_busy_us += bus;
+}
+
+// ------------------------- MPU -------------------------
+enum
+{
+    MPU_IDLE,
+    MPU_COUNT,
+    MPU_BURST,
+};
+
+static uint64_t mpu_produced(double now)
+{
+    return (uint64_t)(now * MPU_RATE_HZ / 1e6);
+}
+
+static void mpu_burst(client_t *c, double now)
+{
+    int n = m.remaining < m.sc->burst_frames ? m.remaining : m.sc->burst_frames;
+    c->state = MPU_BURST;
+    submit(c, now, 1, n * m.sc->frame_size, 0);
+}
+
+static void mpu_timer(client_t *c, double now)
+{
+    c->timer = now + m.sc->wake_samples * 1e6 / MPU_RATE_HZ;
+    if (c->state != MPU_IDLE)
+    {
+        m.wake_pending = true; // binary semaphore: wakeups coalesce
+        return;
+    }
+    c->state = MPU_COUNT;
+    submit(c, now, 1, 2, 0);
+}
+
+static void mpu_done(client_t *c, double now)
+{
+    if (c->state == MPU_COUNT)
+    {
+        uint64_t avail = mpu_produced(now) - m.produced_base - m.consumed;
+        int bytes = (int)(avail * m.sc->frame_size);
+        if (bytes > m.fifo_peak_bytes)
+            m.fifo_peak_bytes = bytes < MPU_FIFO_SIZE ? bytes : MPU_FIFO_SIZE;
+        if (bytes > MPU_FIFO_SIZE)
+        {
+            // Lost; the driver resets the FIFO and starts over
+            m.overflows++;
+            m.produced_base = mpu_produced(now) - m.consumed;
+            avail = 0;
+        }
+        m.remaining = (int)avail;
+    }
+    else
+    {
+        int n = m.remaining < m.sc->burst_frames ? m.remaining : m.sc->burst_frames;
+        m.consumed += n;
+        m.remaining -= n;
+    }
+
+    if (m.remaining > 0)
+    {
+        mpu_burst(c, now);
+        return;
+    }
+    c->state = MPU_IDLE;
+    if (m.wake_pending)
+    {
+        m.wake_pending = false;
+        c->state = MPU_COUNT;
+        submit(c, now, 1, 2, 0);
+    }
+}
+
+// ------------------------- INA226 -------------------------
+// Poll the conversion-ready flag, then read bus voltage, current and power
+static void ina_timer(client_t *c, double now)
+{
+    c->timer = now + INA_PERIOD_US;
+    c->state = 0;
+    submit(c, now, 1, 2, 0);
+}
+
+static void ina_done(client_t *c, double now)
+{
+    if (++c->state < 4)
+        submit(c, now, 1, 2, 0);
+}
+
+// ------------------------- SHTC3 -------------------------
+enum
+{
+    SHTC_WAKE,
+    SHTC_MEASURE,
+    SHTC_WAIT,
+    SHTC_READ,
+    SHTC_SLEEP,
+};
+
+static double shtc_cycle_start;
+
+static void shtc_timer(client_t *c, double now)
+{
+    switch (c->state)
+    {
+    case SHTC_SLEEP: // next cycle
+        shtc_cycle_start = now;
+        c->state = SHTC_WAKE;
+        submit(c, now, 2, 0, 0);
+        break;
+    case SHTC_MEASURE:
+        submit(c, now, 2, 0, 0);
+        break;
+    case SHTC_WAIT:
+        c->state = SHTC_READ;
+        submit(c, now, 0, 6, 0);
+        break;
+    }
+}
+
+static void shtc_done(client_t *c, double now)
+{
+    switch (c->state)
+    {
+    case SHTC_WAKE:
+        c->state = SHTC_MEASURE;
+        c->timer = now + SHTC_WAKEUP_US;
+        break;
+    case SHTC_MEASURE:
+        if (m.sc->shtc_stretch)
+        {
+            c->state = SHTC_READ;
+            submit(c, now, 0, 6, SHTC_MEASURE_US);
+        }
+        else
+        {
+            c->state = SHTC_WAIT;
+            c->timer = now + SHTC_MEASURE_US;
+        }
+        break;
+    case SHTC_READ:
+        c->state = SHTC_SLEEP + 1; // sleep command in flight
+        submit(c, now, 2, 0, 0);
+        break;
+    default:
+        c->state = SHTC_SLEEP;
+        c->timer = shtc_cycle_start + SHTC_PERIOD_US;
+        break;
+    }
+}
+
+// ------------------------- Stuck device -------------------------
+static void stuck_timer(client_t *c, double now)
+{
+    c->timer = now + 2e6;
+    submit(c, now, 1, 1, m.sc->stuck_hold_us);
+}
+
+static void stuck_done(client_t *c, double now)
+{
+    (void)c;
+    (void)now;
+}
+
+// ------------------------- Simulation -------------------------
+static void add_client(const char *name, prio_t prio, double first, client_fn on_timer, client_fn on_done)
+{
+    client_t *c = &m.clients[m.num_clients++];
+    c->name = name;
+    c->prio = prio;
+    c->timer = first;
+    c->on_timer = on_timer;
+    c->on_done = on_done;
+}
+
+// Returns false if the priority policy broke its bound
+static bool run(const scenario_t *sc, double seconds)
+{
+    m = (model_t){.sc = sc, .bus_done_us = INFINITY};
+    add_client("mpu", PRIO_HIGH, 0, mpu_timer, mpu_done);
+    add_client("ina226", PRIO_NORMAL, 3 * INA_PERIOD_US / 7.0, ina_timer, ina_done);
+    add_client("shtc3", PRIO_LOW, 333, shtc_timer, shtc_done);
+    m.clients[2].state = SHTC_SLEEP;
+    if (sc->stuck_hold_us > 0)
+        add_client("stuck", PRIO_LOW, 1777, stuck_timer, stuck_done);
+
+    double end = seconds * 1e6, now = 0;
+    while (now < end)
+    {
+        client_t *next = NULL;
+        for (int i = 0; i < m.num_clients; i++)
+            if (!next || m.clients[i].timer < next->timer)
+                next = &m.clients[i];
+
+        if (m.on_bus && m.bus_done_us <= next->timer)
+        {
+            now = m.bus_done_us;
+            client_t *c = m.on_bus;
+            m.on_bus = NULL;
+            m.bus_done_us = INFINITY;
+            c->on_done(c, now);
+        }
+        else
+        {
+            now = next->timer;
+            next->timer = INFINITY;
+            next->on_timer(next, now);
+        }
+        if (!m.on_bus)
+            bus_start_next(now);
+    }
+
+    // Non-preemptive priority: an MPU transaction waits for at most the one
+    // transaction already on the bus (or the MPU's own previous one), and a
+    // FIFO burst is never cut off for its length alone
+    double other_max = 0;
+    for (int i = 1; i < m.num_clients; i++)
+        if (m.clients[i].bus_max_us > other_max)
+            other_max = m.clients[i].bus_max_us;
+    const client_t *mpu = &m.clients[0];
+    bool bound_ok = sc->arb != ARB_PRIORITY || mpu->wait_max_us <= fmax(other_max, mpu->bus_max_us) + 1e-6;
+    bound_ok = bound_ok && mpu->aborted == 0;
+
+    uint32_t aborted = 0;
+    for (int i = 1; i < m.num_clients; i++)
+        aborted += m.clients[i].aborted;
+
+    printf("%-22s %-8s mpu wait max %6.0f us, bus max %6.0f us, timeouts %4u | "
+           "others timeouts %3u | fifo peak %4d B, overflows %3u | bus %4.1f%%%s\n",
+           sc->name, sc->arb == ARB_FIFO ? "fifo" : "priority", mpu->wait_max_us, mpu->bus_max_us,
+           mpu->aborted, aborted, m.fifo_peak_bytes, m.overflows, 100.0 * m.bus_busy_us / end,
+           bound_ok ? "" : "  FAIL: priority bound");
+    return bound_ok && !(sc->arb == ARB_PRIORITY && sc->stuck_hold_us == 0 && m.overflows);
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 60.0;
+    const double stuck = XFER_TIMEOUT_MS * 1000.0;
+    const scenario_t scenarios[] = {
+        {"nominal", ARB_FIFO, 6, 64, 1, false, 0},
+        {"nominal", ARB_PRIORITY, 6, 64, 1, false, 0},
+        {"watermark 10", ARB_FIFO, 6, 64, 10, false, 0},
+        {"watermark 10", ARB_PRIORITY, 6, 64, 10, false, 0},
+        {"shtc3 clock stretch", ARB_FIFO, 6, 64, 1, true, 0},
+        {"shtc3 clock stretch", ARB_PRIORITY, 6, 64, 1, true, 0},
+        {"stuck device", ARB_FIFO, 14, 64, 10, false, stuck},
+        {"stuck device", ARB_PRIORITY, 14, 64, 10, false, stuck},
+        {"14 B, watermark 70", ARB_PRIORITY, 14, 64, 70, false, 0},
+    };
+
+    int fail = 0;
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+        fail |= !run(&scenarios[i], seconds);
+    printf(fail ? "FAIL\n" : "PASS\n");
+    return fail;
+}
@@ -0,0 +1,20 @@
+#ifndef HOST_DSPS_DOTPROD_H
+#define HOST_DSPS_DOTPROD_H
+
+#include "esp_err.h"
+#include <assert.h>
+#include <stdint.h>
+
+// Plain C version of the esp-dsp kernel (same as its _ansi variant). The
+// ESP32-S3 kernel loads 16 bytes at a time, so the inputs must be aligned.
+static inline esp_err_t dsps_dotprod_f32(const float *src1, const float *src2, float *dest, int len)
+{
+    assert(((uintptr_t)src1 & 15) == 0 && ((uintptr_t)src2 & 15) == 0);
+    float acc = 0.0f;
+    for (int i = 0; i < len; i++)
+        acc += src1[i] * src2[i];
+    *dest = acc;
+    return ESP_OK;
+}
+
+#endif // HOST_DSPS_DOTPROD_H
@@ -0,0 +1,20 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+// Just enough of FreeRTOS for the host tests to compile the pure modules
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef void *QueueHandle_t;
+typedef void *SemaphoreHandle_t;
+typedef void *TaskHandle_t;
+
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFUL)
+#define configTICK_RATE_HZ 1000
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define pdTRUE 1
+#define pdFALSE 0
+
+#endif // HOST_FREERTOS_H
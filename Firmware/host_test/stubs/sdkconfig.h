@@ -0,0 +1,8 @@
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+
+// Values from Firmware/sdkconfig that the host-built modules read. Options
+// that are "not set" there stay undefined here, as in the generated header;
+// a test target may add its own with target_compile_definitions().
+
+#endif // HOST_SDKCONFIG_H
@@ -0,0 +1,191 @@
+// Trace test for the attitude estimator (attitude.c). A 1 kHz trace holds a
+// static tilt, a slow 30 degree roll (below the movement threshold), a fast
+// roll back (above it) and a second static hold, with a 50 Hz compressor
+// vibration and sensor noise on top the whole time. It runs once with gyro
+// data, as the FIFO layouts with gyro deliver it, and once accelerometer
+// only. Pitch, roll and tilt must stay within the error bounds of each
+// phase, and the moving flag must be set during the fast roll only.
+
+#include "attitude.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define RATE_HZ 1000
+#define PITCH_DEG 5.0f
+#define ROLL0_DEG -3.0f
+#define SLOW_ROLL_DEG 30.0f
+#define VIB_G 0.2f  // 50 Hz vibration amplitude per axis
+#define VIB_DPS 2.0f // and its angular component in the gyro
+
+typedef enum
+{
+    PHASE_SETTLE, // filter settling, reference taken at the end
+    PHASE_STATIC,
+    PHASE_SLOW,   // +30 degrees of roll over 3 s (10 deg/s)
+    PHASE_FAST,   // back over 0.5 s (60 deg/s)
+    PHASE_RECOVER,
+    PHASE_HOLD,
+    PHASES
+} phase_t;
+
+static const struct
+{
+    const char *name;
+    float seconds;
+} phases[PHASES] = {
+    {"settle", 3.0f}, {"static", 2.0f}, {"slow roll", 3.0f}, {"fast roll", 0.5f}, {"recover", 2.0f}, {"hold", 2.0f},
+};
+
+// Error bounds (degrees) for pitch/roll and tilt, per phase; 0: not checked
+typedef struct
+{
+    float angle[PHASES];
+    float tilt[PHASES];
+} bounds_t;
+
+static const bounds_t with_gyro = {
+    .angle = {0, 0.5f, 1.0f, 1.0f, 1.0f, 0.5f},
+    .tilt = {0, 0.5f, 1.0f, 1.0f, 1.0f, 0.5f},
+};
+// Without gyro the estimate lags a rotation by about tau x rate (0.5 s x 10
+// deg/s) and needs a few time constants to catch up after the fast roll
+static const bounds_t accel_only = {
+    .angle = {0, 0.5f, 6.0f, 0, 0, 0.5f},
+    .tilt = {0, 0.5f, 6.0f, 0, 0, 0.5f},
+};
+
+static float noise(unsigned *rng, float amplitude)
+{
+    *rng = *rng * 1103515245u + 12345u;
+    return (((*rng >> 16) & 0xFF) - 127.5f) / 127.5f * amplitude;
+}
+
+static int16_t counts(float v)
+{
+    long c = lroundf(v);
+    return (int16_t)(c > INT16_MAX ? INT16_MAX : c < INT16_MIN ? INT16_MIN : c);
+}
+
+static float rad(float deg)
+{
+    return deg * (float)M_PI / 180.0f;
+}
+
+// Gravity in the sensor frame for a pitch and roll, in g
+static void gravity(float pitch_deg, float roll_deg, float g[3])
+{
+    float p = rad(pitch_deg), r = rad(roll_deg);
+    g[0] = -sinf(p);
+    g[1] = sinf(r) * cosf(p);
+    g[2] = cosf(r) * cosf(p);
+}
+
+static float angle_deg(const float a[3], const float b[3])
+{
+    float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    return acosf(fminf(1.0f, fmaxf(-1.0f, dot))) * 180.0f / (float)M_PI;
+}
+
+// Roll at time t (s from the start of the trace) and its rate (deg/s)
+static float roll_at(float t, float *rate_dps)
+{
+    float slow_start = phases[PHASE_SETTLE].seconds + phases[PHASE_STATIC].seconds;
+    float fast_start = slow_start + phases[PHASE_SLOW].seconds;
+    float fast_end = fast_start + phases[PHASE_FAST].seconds;
+    *rate_dps = 0.0f;
+    if (t < slow_start)
+        return ROLL0_DEG;
+    if (t < fast_start)
+    {
+        *rate_dps = SLOW_ROLL_DEG / phases[PHASE_SLOW].seconds;
+        return ROLL0_DEG + (t - slow_start) * *rate_dps;
+    }
+    if (t < fast_end)
+    {
+        *rate_dps = -SLOW_ROLL_DEG / phases[PHASE_FAST].seconds;
+        return ROLL0_DEG + SLOW_ROLL_DEG + (t - fast_start) * *rate_dps;
+    }
+    return ROLL0_DEG;
+}
+
+static int run(const char *name, bool use_gyro, const bounds_t *bounds)
+{
+    attitude_t a;
+    attitude_init(&a, RATE_HZ);
+    unsigned rng = 1;
+    float ref[3]; // taken while settling, before the first rotation
+    gravity(PITCH_DEG, ROLL0_DEG, ref);
+
+    float max_angle[PHASES] = {0}, max_tilt[PHASES] = {0};
+    bool moving[PHASES] = {0};
+    bool tilted_at_top = false;
+    int i = 0, fail = 0;
+    for (int ph = 0; ph < PHASES; ph++)
+    {
+        int n = (int)lroundf(phases[ph].seconds * RATE_HZ);
+        for (int k = 0; k < n; k++, i++)
+        {
+            float t = (float)i / RATE_HZ, rate;
+            float roll = roll_at(t, &rate), g[3];
+            gravity(PITCH_DEG, roll, g);
+
+            float vib = sinf(2.0f * (float)M_PI * 50.0f * t);
+            int16_t accel[3], gyro[3];
+            for (int ax = 0; ax < 3; ax++)
+                accel[ax] = counts((g[ax] + VIB_G * vib + noise(&rng, 0.005f)) * MPU_ACCEL_LSB_PER_G);
+            gyro[0] = counts((rate + VIB_DPS * vib + noise(&rng, 0.1f)) * MPU_GYRO_LSB_PER_DPS);
+            gyro[1] = counts((VIB_DPS * vib + noise(&rng, 0.1f)) * MPU_GYRO_LSB_PER_DPS);
+            gyro[2] = counts(noise(&rng, 0.1f) * MPU_GYRO_LSB_PER_DPS);
+
+            sensor_attitude_t out;
+            if (!attitude_update(&a, accel, use_gyro ? gyro : NULL, &out))
+                continue;
+            if (ph == PHASE_SETTLE)
+                continue;
+            if (!a.ref_valid)
+            {
+                printf("FAIL: %s: no reference after settling\n", name);
+                return 1;
+            }
+            float err = fmaxf(fabsf(out.motion.pitch - PITCH_DEG), fabsf(out.motion.roll - roll));
+            float tilt_err = fabsf(out.tilt_deg - angle_deg(g, ref));
+            max_angle[ph] = fmaxf(max_angle[ph], err);
+            max_tilt[ph] = fmaxf(max_tilt[ph], tilt_err);
+            moving[ph] |= out.moving;
+            if (ph == PHASE_SLOW && k == n - 1)
+                tilted_at_top = out.tilted;
+        }
+    }
+
+    printf("%s\n", name);
+    for (int ph = PHASE_STATIC; ph < PHASES; ph++)
+    {
+        bool bounded = (!bounds->angle[ph] || max_angle[ph] <= bounds->angle[ph]) &&
+                       (!bounds->tilt[ph] || max_tilt[ph] <= bounds->tilt[ph]);
+        bool want_moving = ph == PHASE_FAST;
+        // Without gyro the estimate still turns fast for a while after the roll
+        bool moving_ok = moving[ph] == want_moving || (ph == PHASE_RECOVER && !use_gyro);
+        printf("  %-10s max error: pitch/roll %5.2f deg, tilt %5.2f deg  moving %d\n", phases[ph].name,
+               max_angle[ph], max_tilt[ph], moving[ph]);
+        if (!bounded || !moving_ok)
+        {
+            printf("FAIL: %s, %s phase\n", name, phases[ph].name);
+            fail = 1;
+        }
+    }
+    if (!tilted_at_top || a.move_events != 1)
+    {
+        printf("FAIL: %s: tilted %d after the slow roll, %u move events\n", name, tilted_at_top,
+               (unsigned)a.move_events);
+        fail = 1;
+    }
+    return fail;
+}
+
+int main(void)
+{
+    int fail = run("with gyro", true, &with_gyro);
+    fail |= run("accelerometer only", false, &accel_only);
+    printf(fail ? "FAIL\n" : "PASS\n");
+    return fail;
+}
@@ -0,0 +1,66 @@
+// Attenuation test for the stream decimator (decimator.c). A unit sine is fed
+// through the cascade and the output amplitude is measured once the filters
+// have settled: in-band tones must pass at unity gain, tones that would alias
+// into the output band must be suppressed.
+
+#include "decimator.h"
+#include <math.h>
+#include <stdio.h>
+
+#define INPUT_RATE_HZ 1000
+#define PASS_TOL_DB 0.5f     // in-band ripple, up to half the -6 dB corner
+#define STOP_MIN_DB 60.0f    // from 1.5x the output Nyquist frequency up
+
+// Peak output amplitude (dB re input) for a tone at freq_hz on every axis
+static float tone_gain_db(int output_rate_hz, float freq_hz)
+{
+    static decimator_t d;
+    if (decimator_init(&d, INPUT_RATE_HZ, output_rate_hz) != ESP_OK)
+        return NAN;
+
+    int settle = (int)d.delay_samples * 2 + INPUT_RATE_HZ; // input samples
+    int total = settle + 20 * INPUT_RATE_HZ;
+    float peak = 0.0f;
+    for (int n = 0; n < total; n++)
+    {
+        float in[DECIM_AXES], out[DECIM_AXES];
+        float v = sinf(2.0f * (float)M_PI * freq_hz * n / INPUT_RATE_HZ);
+        for (int a = 0; a < DECIM_AXES; a++)
+            in[a] = v;
+        if (decimator_push(&d, in, out) && n >= settle)
+            peak = fmaxf(peak, fabsf(out[0]));
+    }
+    return 20.0f * log10f(fmaxf(peak, 1e-9f));
+}
+
+int main(void)
+{
+    static const int rates[] = {10, 20, 25, 50, 100};
+    static const float stop_mult[] = {1.5f, 2.3f, 4.7f, 9.1f, 19.7f, 47.3f};
+    int fail = 0;
+
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+    {
+        int rate = rates[r];
+        float nyquist = rate / 2.0f;
+
+        float pass_hz = 0.4f * nyquist;
+        float pass = tone_gain_db(rate, pass_hz);
+        int bad = fabsf(pass) > PASS_TOL_DB;
+        printf("%3d Hz: pass %6.2f Hz %7.2f dB%s\n", rate, pass_hz, pass, bad ? "  FAIL" : "");
+        fail |= bad;
+
+        for (size_t i = 0; i < sizeof(stop_mult) / sizeof(stop_mult[0]); i++)
+        {
+            float f = stop_mult[i] * nyquist;
+            if (f >= INPUT_RATE_HZ / 2.0f)
+                continue;
+            float g = tone_gain_db(rate, f);
+            bad = g > -STOP_MIN_DB;
+            printf("        stop %6.2f Hz %7.2f dB%s\n", f, g, bad ? "  FAIL" : "");
+            fail |= bad;
+        }
+    }
+    printf(fail ? "FAIL\n" : "PASS\n");
+    return fail;
+}
@@ -0,0 +1,124 @@
+// Sequence gap test for the PSRAM history (sample_history.c). Samples are
+// appended at 1 kHz with the sequence number jumping ahead twice, as after a
+// FIFO overflow: once within a keyframe block and once across several. The
+// skipped sequence numbers must read back as lost, and every stored sample
+// must come back with its own values and exact timestamp, including reads
+// that start right after a gap or walk through one. A second history runs
+// its sequence numbers through the 32-bit wrap.
+
+#include "sample_history.h"
+#include <stdio.h>
+
+#define CAPACITY 4096
+#define PERIOD_US 1000
+
+static int16_t axis(uint32_t seq, int a)
+{
+    return (int16_t)((seq * 7 + a * 1000) & 0x3FFF);
+}
+
+static uint64_t timestamp(uint32_t seq)
+{
+    return 5000000 + (uint64_t)seq * PERIOD_US;
+}
+
+static bool lost(uint32_t seq)
+{
+    return (seq >= 1000 && seq < 1010) || (seq >= 2000 && seq < 2900);
+}
+
+int main(void)
+{
+    static sample_history_t h;
+    if (sample_history_init(&h, CAPACITY) != ESP_OK)
+        return 1;
+
+    for (uint32_t seq = 0; seq < 3500; seq++)
+        if (!lost(seq))
+            sample_history_append(&h, seq, axis(seq, 0), axis(seq, 1), axis(seq, 2), timestamp(seq));
+
+    int fail = 0;
+    static const uint32_t starts[] = {0, 5, 999, 1010, 1011, 1500, 2000, 2450, 2900, 2901, 3100};
+    for (size_t i = 0; i < sizeof(starts) / sizeof(starts[0]); i++)
+    {
+        synchronized_sample_t out[200];
+        uint32_t start = starts[i];
+        size_t n = sample_history_read(&h, start, out, 200);
+        if (n != 200)
+        {
+            printf("FAIL: read at %u returned %zu samples\n", start, n);
+            fail = 1;
+            continue;
+        }
+        for (size_t k = 0; k < n; k++)
+        {
+            uint32_t seq = start + (uint32_t)k;
+            const synchronized_sample_t *s = &out[k];
+            bool ok = s->seq == seq && s->timestamp_us == timestamp(seq);
+            if (lost(seq))
+                ok = ok && isnan(s->accel_x_g) && isnan(s->magnitude);
+            else
+                ok = ok && s->accel_x_g == axis(seq, 0) / MPU_ACCEL_LSB_PER_G &&
+                     s->accel_z_g == axis(seq, 2) / MPU_ACCEL_LSB_PER_G;
+            if (!ok)
+            {
+                printf("FAIL: read at %u, seq %u: t %llu (want %llu), x %f\n", start, seq,
+                       (unsigned long long)s->timestamp_us, (unsigned long long)timestamp(seq), s->accel_x_g);
+                fail = 1;
+                break;
+            }
+        }
+    }
+
+    sensor_raw_record_t raw[16];
+    if (sample_history_read_raw(&h, 1000, raw, 16) != 16 || !sensor_raw_record_lost(&raw[9]) ||
+        sensor_raw_record_lost(&raw[10]))
+    {
+        printf("FAIL: raw records around the first gap\n");
+        fail = 1;
+    }
+
+    // A real sample at negative full scale on every axis must not read as lost
+    sample_history_append(&h, 3500, INT16_MIN, INT16_MIN, INT16_MIN, timestamp(3500));
+    if (sample_history_read_raw(&h, 3500, raw, 1) != 1 || sensor_raw_record_lost(&raw[0]))
+    {
+        printf("FAIL: saturated sample stored as lost\n");
+        fail = 1;
+    }
+
+    // Sequence numbers wrap after 2^32 samples (about 5 days at 10 kHz)
+    static sample_history_t w;
+    if (sample_history_init(&w, CAPACITY) != ESP_OK)
+        return 1;
+    const uint32_t base = UINT32_MAX - 2999;
+    for (uint32_t i = 0; i < 6000; i++)
+        sample_history_append(&w, base + i, axis(i, 0), axis(i, 1), axis(i, 2), timestamp(i));
+    uint32_t oldest, next;
+    sample_history_range(&w, &oldest, &next);
+    if (next != base + 6000 || (int32_t)(next - oldest) > CAPACITY || (int32_t)(next - oldest) < CAPACITY - SAMPLE_HISTORY_KEYFRAME_INTERVAL)
+    {
+        printf("FAIL: range across the wrap: oldest %u, next %u\n", oldest, next);
+        fail = 1;
+    }
+    synchronized_sample_t out[200];
+    uint32_t start = UINT32_MAX - 99; // reads through the wrap
+    size_t n = sample_history_read(&w, start, out, 200);
+    for (size_t k = 0; k < n && !fail; k++)
+    {
+        uint32_t i = start + (uint32_t)k - base;
+        if (out[k].seq != start + (uint32_t)k || out[k].timestamp_us != timestamp(i) ||
+            out[k].accel_x_g != axis(i, 0) / MPU_ACCEL_LSB_PER_G)
+        {
+            printf("FAIL: read across the wrap, seq %u\n", out[k].seq);
+            fail = 1;
+        }
+    }
+    if (n != 200)
+    {
+        printf("FAIL: read across the wrap returned %zu samples\n", n);
+        fail = 1;
+    }
+
+    printf(fail ? "FAIL\n" : "PASS\n");
+    return fail;
+}
@@ -0,0 +1,246 @@
+#include "batch_codec.h"
+#include <math.h>
+#include <string.h>
+
+typedef struct
+{
+    uint16_t bit;
+    size_t offset; // float field in synchronized_sample_t
+    float scale;   // unit per LSB, 0 = fitted to the batch
+} batch_channel_t;
+
+// Accel and gyro use the sensor's own LSB, so raw counts survive unchanged
+static const batch_channel_t channels[] = {
+    {BATCH_CH_AX, offsetof(synchronized_sample_t, accel_x_g), 1.0f / MPU_ACCEL_LSB_PER_G},
+    {BATCH_CH_AY, offsetof(synchronized_sample_t, accel_y_g), 1.0f / MPU_ACCEL_LSB_PER_G},
+    {BATCH_CH_AZ, offsetof(synchronized_sample_t, accel_z_g), 1.0f / MPU_ACCEL_LSB_PER_G},
+#if CONFIG_MPU6050_FIFO_GYRO
+    {BATCH_CH_GX, offsetof(synchronized_sample_t, gyro_x_dps), 1.0f / MPU_GYRO_LSB_PER_DPS},
+    {BATCH_CH_GY, offsetof(synchronized_sample_t, gyro_y_dps), 1.0f / MPU_GYRO_LSB_PER_DPS},
+    {BATCH_CH_GZ, offsetof(synchronized_sample_t, gyro_z_dps), 1.0f / MPU_GYRO_LSB_PER_DPS},
+#endif
+#if CONFIG_MPU6050_FIFO_TEMP
+    {BATCH_CH_TD, offsetof(synchronized_sample_t, die_temperature_c), 0.01f},
+#endif
+    {BATCH_CH_I, offsetof(synchronized_sample_t, latest_current_a), 0.0f},
+    {BATCH_CH_T, offsetof(synchronized_sample_t, latest_temperature_c), 0.01f},
+};
+#define NUM_CHANNELS (sizeof(channels) / sizeof(channels[0]))
+
+static inline float field(const synchronized_sample_t *s, size_t offset)
+{
+    float v;
+    memcpy(&v, (const uint8_t *)s + offset, sizeof(v));
+    return v;
+}
+
+static inline int16_t quantize(float v, float inv_scale)
+{
+    float q = v * inv_scale;
+    if (isnan(q))
+        return BATCH_CODEC_NAN;
+    if (q >= INT16_MAX)
+        return INT16_MAX;
+    if (q <= BATCH_CODEC_NAN + 1)
+        return BATCH_CODEC_NAN + 1;
+    return (int16_t)lrintf(q);
+}
+
+// ----- Compressed columns -----
+// MSB-first bit stream. Every number is a zig-zag value in a prefix code:
+// '0' = 0, '10' + 3 bits, '110' + 8 bits, '1110' + 13 bits, '1111' + 32 bits.
+typedef struct
+{
+    uint8_t *p;
+    uint8_t *end;
+    uint64_t acc;
+    int bits; // pending bits in acc, < 8 between calls
+    bool full;
+} bit_writer_t;
+
+static void bits_put(bit_writer_t *bw, uint32_t value, int n)
+{
+    bw->acc = (bw->acc << n) | (value & (uint32_t)((1ull << n) - 1));
+    bw->bits += n;
+    while (bw->bits >= 8)
+    {
+        bw->bits -= 8;
+        if (bw->p < bw->end)
+            *bw->p++ = (uint8_t)(bw->acc >> bw->bits);
+        else
+            bw->full = true;
+    }
+}
+
+static void bits_flush(bit_writer_t *bw)
+{
+    if (bw->bits)
+        bits_put(bw, 0, 8 - bw->bits);
+}
+
+static void put_code(bit_writer_t *bw, uint32_t zz)
+{
+    if (zz == 0)
+        bits_put(bw, 0x0, 1);
+    else if (zz < (1u << 3))
+    {
+        bits_put(bw, 0x2, 2);
+        bits_put(bw, zz, 3);
+    }
+    else if (zz < (1u << 8))
+    {
+        bits_put(bw, 0x6, 3);
+        bits_put(bw, zz, 8);
+    }
+    else if (zz < (1u << 13))
+    {
+        bits_put(bw, 0xE, 4);
+        bits_put(bw, zz, 13);
+    }
+    else
+    {
+        bits_put(bw, 0xF, 4);
+        bits_put(bw, zz, 32);
+    }
+}
+
+static inline uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+// Timestamps as delta-of-delta (exact, so clock corrections survive), seq
+// steps if the batch has gaps, then every column as first value + deltas.
+// Returns the stream length, 0 if it would not be smaller than plain columns.
+static size_t encode_compressed(const synchronized_sample_t *samples, int count, bool gaps,
+                                const float *scales, uint8_t *out, size_t limit)
+{
+    bit_writer_t bw = {.p = out, .end = out + limit};
+
+    int64_t prev_delta = 0;
+    for (int i = 1; i < count; i++)
+    {
+        int64_t delta = (int64_t)(samples[i].timestamp_us - samples[i - 1].timestamp_us);
+        int64_t dod = delta - prev_delta;
+        if (dod > INT32_MAX || dod < INT32_MIN)
+            return 0;
+        put_code(&bw, zigzag((int32_t)dod));
+        prev_delta = delta;
+    }
+
+    if (gaps)
+    {
+        for (int i = 1; i < count; i++)
+            put_code(&bw, samples[i].seq - samples[i - 1].seq - 1);
+    }
+
+    for (size_t c = 0; c < NUM_CHANNELS && !bw.full; c++)
+    {
+        size_t off = channels[c].offset;
+        float inv = 1.0f / scales[c];
+        int16_t prev = quantize(field(&samples[0], off), inv);
+        bits_put(&bw, (uint16_t)prev, 16);
+        for (int i = 1; i < count; i++)
+        {
+            int16_t q = quantize(field(&samples[i], off), inv);
+            put_code(&bw, zigzag((int32_t)q - prev));
+            prev = q;
+        }
+    }
+    bits_flush(&bw);
+    return bw.full ? 0 : (size_t)(bw.p - out);
+}
+
+size_t batch_codec_max_size(int count)
+{
+    return sizeof(batch_codec_header_t) + BATCH_CH_COUNT * sizeof(float) +
+           (size_t)count * (BATCH_CH_COUNT * sizeof(int16_t) + sizeof(uint32_t));
+}
+
+size_t batch_codec_encode(const synchronized_sample_t *samples, int count, batch_encoding_t encoding,
+                          uint8_t *out, size_t out_size)
+{
+    if (count <= 0 || count > UINT16_MAX)
+        return 0;
+
+    const synchronized_sample_t *first = &samples[0], *last = &samples[count - 1];
+    uint32_t span = last->seq - first->seq;
+    bool gaps = span != (uint32_t)(count - 1);
+    size_t seq_size = span > UINT16_MAX ? sizeof(uint32_t) : sizeof(uint16_t);
+    size_t head_len = sizeof(batch_codec_header_t) + NUM_CHANNELS * sizeof(float);
+    size_t plain_len = head_len + NUM_CHANNELS * count * sizeof(int16_t) + (gaps ? count * seq_size : 0);
+    if (plain_len > out_size)
+        return 0;
+
+    batch_codec_header_t hdr = {
+        .magic = {BATCH_CODEC_MAGIC0, BATCH_CODEC_MAGIC1},
+        .version = BATCH_CODEC_VERSION,
+        .flags = (gaps ? BATCH_FLAG_SEQ : 0) | (seq_size == sizeof(uint32_t) ? BATCH_FLAG_SEQ32 : 0),
+        .count = (uint16_t)count,
+        .first_seq = first->seq,
+        .start_us = first->timestamp_us,
+        .period_ns = span ? (uint32_t)((last->timestamp_us - first->timestamp_us) * 1000 / span) : 0,
+    };
+    for (size_t c = 0; c < NUM_CHANNELS; c++)
+        hdr.channels |= channels[c].bit;
+
+    float scales[NUM_CHANNELS];
+    for (size_t c = 0; c < NUM_CHANNELS; c++)
+    {
+        scales[c] = channels[c].scale;
+        if (scales[c] == 0.0f)
+        {
+            float max = 0.0f;
+            for (int i = 0; i < count; i++)
+            {
+                float a = fabsf(field(&samples[i], channels[c].offset));
+                if (a > max)
+                    max = a;
+            }
+            scales[c] = max > 0.0f ? max / INT16_MAX : 1e-6f;
+        }
+    }
+    memcpy(out + sizeof(hdr), scales, sizeof(scales));
+
+    // Compressed only if it beats plain columns; some traces do not compress
+    if (encoding == BATCH_ENCODING_COMPRESSED)
+    {
+        size_t len = encode_compressed(samples, count, gaps, scales, out + head_len, plain_len - head_len - 1);
+        if (len)
+        {
+            hdr.flags = (hdr.flags & ~BATCH_FLAG_SEQ32) | BATCH_FLAG_COMPRESSED;
+            memcpy(out, &hdr, sizeof(hdr));
+            return head_len + len;
+        }
+    }
+    memcpy(out, &hdr, sizeof(hdr));
+
+    uint8_t *p = out + head_len;
+    for (size_t c = 0; c < NUM_CHANNELS; c++)
+    {
+        float inv = 1.0f / scales[c];
+        for (int i = 0; i < count; i++, p += sizeof(int16_t))
+        {
+            int16_t q = quantize(field(&samples[i], channels[c].offset), inv);
+            memcpy(p, &q, sizeof(q));
+        }
+    }
+
+    if (gaps)
+    {
+        for (int i = 0; i < count; i++, p += seq_size)
+        {
+            uint32_t d = samples[i].seq - first->seq;
+            if (seq_size == sizeof(uint16_t))
+            {
+                uint16_t q = (uint16_t)d;
+                memcpy(p, &q, sizeof(q));
+            }
+            else
+            {
+                memcpy(p, &d, sizeof(d));
+            }
+        }
+    }
+    return plain_len;
+}
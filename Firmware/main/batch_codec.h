@@ -0,0 +1,83 @@
+#ifndef BATCH_CODEC_H
+#define BATCH_CODEC_H
+
+#include "sensor_manager.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary training batch, little-endian:
+//
+//   batch_codec_header_t
+//   float scale[n]           physical unit per LSB, one per channel present
+//   int16_t column[n][count] one column per channel, in channel bit order
+//   uint16_t seq[count]      only with BATCH_FLAG_SEQ: seq - first_seq
+//                            (uint32_t with BATCH_FLAG_SEQ32)
+//
+// Timestamps are start_us + (seq - first_seq) * period_ns / 1000. Without
+// BATCH_FLAG_SEQ the samples are consecutive. A value of BATCH_CODEC_NAN
+// stands for a missing measurement (NAN); real values saturate one LSB
+// above it.
+//
+// With BATCH_FLAG_COMPRESSED the columns are replaced by one MSB-first bit
+// stream of prefix-coded zig-zag numbers ('0' = 0, '10' + 3 bits, '110' + 8,
+// '1110' + 13, '1111' + 32), zero-padded to a whole byte:
+//
+//   count - 1 timestamp delta-of-deltas (µs, the first delta against 0)
+//   count - 1 seq steps minus one       only with BATCH_FLAG_SEQ, not zig-zagged
+//   per channel: first value as raw 16 bits, then count - 1 value deltas
+//
+// Timestamps are then exact per sample rather than derived from period_ns.
+// Decoder: tools/decode_batch.py
+
+#define BATCH_CODEC_MAGIC0 'S'
+#define BATCH_CODEC_MAGIC1 'B'
+#define BATCH_CODEC_VERSION 2 // 2: BATCH_CODEC_NAN, BATCH_FLAG_SEQ32
+#define BATCH_CODEC_NAN INT16_MIN
+
+// Channels, in column order
+#define BATCH_CH_AX 0x0001
+#define BATCH_CH_AY 0x0002
+#define BATCH_CH_AZ 0x0004
+#define BATCH_CH_GX 0x0008
+#define BATCH_CH_GY 0x0010
+#define BATCH_CH_GZ 0x0020
+#define BATCH_CH_TD 0x0040 // MPU die temperature
+#define BATCH_CH_I 0x0080  // compressor current
+#define BATCH_CH_T 0x0100  // ambient temperature
+#define BATCH_CH_COUNT 9
+
+#define BATCH_FLAG_SEQ 0x01        // the batch spans lost samples
+#define BATCH_FLAG_COMPRESSED 0x02 // bit-packed columns
+#define BATCH_FLAG_SEQ32 0x04      // plain seq column is 32-bit: the batch spans over 65535 seqs
+
+typedef enum
+{
+    BATCH_ENCODING_PLAIN = 0,
+    BATCH_ENCODING_COMPRESSED, // falls back to plain where that is smaller
+} batch_encoding_t;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t magic[2];
+    uint8_t version;
+    uint8_t flags;
+    uint16_t channels; // BATCH_CH_* mask
+    uint16_t count;
+    uint32_t first_seq;
+    uint64_t start_us;
+    uint32_t period_ns; // mean sample period over the batch, 0 for a single sample
+} batch_codec_header_t;
+
+/**
+ * @brief Upper bound of the encoded size of a batch of count samples.
+ */
+size_t batch_codec_max_size(int count);
+
+/**
+ * @brief Encode samples (sorted by seq) into out. Allocates nothing.
+ * @return Encoded length, 0 if out is too small
+ */
+size_t batch_codec_encode(const synchronized_sample_t *samples, int count, batch_encoding_t encoding,
+                          uint8_t *out, size_t out_size);
+
+#endif // BATCH_CODEC_H
@@ -1,9 +1,16 @@
-#include "cJSON.h"
 #include "network_manager.h"
 #include "sensor_manager.h"
+#include "batch_codec.h"
+#include "json_writer.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "cJSON.h"
+#include <math.h>
+#include <string.h>
 
 #define MIN_SETPOINT_TEMP 18.0f
 #define MAX_SETPOINT_TEMP 30.0f
@@ -13,102 +20,537 @@
 #define TRAINING_TOPIC "device/training/samples"
 // Real-time visualization topic
 #define STREAM_TOPIC "device/realtime/samples"
+// Vibration spectrum peaks
+#define SPECTRUM_TOPIC "device/realtime/spectrum"
+// Windowed vibration statistics (machine health), once per window
+#define VIBRATION_TOPIC "device/health/vibration"
+// Compressor power and accumulated energy, once per second
+#define POWER_TOPIC "device/health/power"
+// Acquisition health counters, every 10 s
+#define HEALTH_TOPIC "device/health/sensors"
 
-#define PUBLISH_MODE_BATCH 1
-#define PUBLISH_MODE_STREAM 2
+// Runtime stream configuration (JSON, see on_config_message())
+#define CONFIG_TOPIC "device/publisher/config"
+// Stream configuration in effect, published after every change
+#define STATE_TOPIC "device/publisher/state"
 
-static int publish_mode = PUBLISH_MODE_STREAM;
 static const char *TAG = "DATA_PUBLISHER";
 
+// Encoded training batch, allocated the first time training is enabled
+static uint8_t *batch_tx;
+static size_t batch_tx_size;
+
 // ------------------------- JSON Publishers -------------------------
+// All JSON payloads fit the network manager's 256-byte message slots
+#define JSON_PAYLOAD_MAX 256
+
+static void publish_json(const char *topic, json_writer_t *w)
+{
+    const char *json = json_writer_finish(w);
+    if (json)
+        network_manager_publish(topic, json); // Non-blocking publish (queued)
+    else
+        ESP_LOGW(TAG, "Payload for %s truncated, dropped", topic);
+}
 
 void publish_slider_setpoint(uint8_t slider_percentage)
 {
     float temp_range = MAX_SETPOINT_TEMP - MIN_SETPOINT_TEMP;
     float new_setpoint = MIN_SETPOINT_TEMP + ((float)slider_percentage / 100.0f) * temp_range;
 
-    cJSON *root = cJSON_CreateObject();
-    if (!root)
-        return;
+    char json[64];
+    json_writer_t w;
+    json_writer_init(&w, json, sizeof(json));
+    json_object_begin(&w);
+    json_kv_uint(&w, "percentage", slider_percentage);
+    json_kv_float(&w, "temperature_c", new_setpoint, 2);
+    json_object_end(&w);
+    publish_json(SETPOINT_MQTT_TOPIC, &w);
+}
+
+static void publish_sample(const synchronized_sample_t *pkt)
+{
+    char json[JSON_PAYLOAD_MAX];
+    json_writer_t w;
+    json_writer_init(&w, json, sizeof(json));
+    json_object_begin(&w);
+    json_kv_uint(&w, "t", pkt->timestamp_us);
+    json_kv_float(&w, "ax", pkt->accel_x_g, 3);
+    json_kv_float(&w, "ay", pkt->accel_y_g, 3);
+    json_kv_float(&w, "az", pkt->accel_z_g, 3);
+#if CONFIG_MPU6050_FIFO_GYRO
+    json_kv_float(&w, "gx", pkt->gyro_x_dps, 2);
+    json_kv_float(&w, "gy", pkt->gyro_y_dps, 2);
+    json_kv_float(&w, "gz", pkt->gyro_z_dps, 2);
+#endif
+#if CONFIG_MPU6050_FIFO_TEMP
+    json_kv_float(&w, "Td", pkt->die_temperature_c, 2);
+#endif
+    json_kv_float(&w, "I", pkt->latest_current_a, 3);
+    json_kv_float(&w, "T", pkt->latest_temperature_c, 2);
+    json_object_end(&w);
+    publish_json(STREAM_TOPIC, &w);
+}
+
+static void publish_spectrum(const sensor_spectrum_t *spec)
+{
+    char json[JSON_PAYLOAD_MAX];
+    json_writer_t w;
+    json_writer_init(&w, json, sizeof(json));
+    json_object_begin(&w);
+    json_kv_uint(&w, "t", spec->timestamp_us);
+    json_kv_float(&w, "rms", spec->rms_g, 4);
+    json_kv_float(&w, "df", spec->resolution_hz, 3);
+    json_kv_uint(&w, "us", spec->compute_us);
+    json_key(&w, "p");
+    json_array_begin(&w);
+    for (int i = 0; i < spec->num_peaks; i++)
+    {
+        json_array_begin(&w);
+        json_float(&w, spec->peaks[i].freq_hz, 2);
+        json_float(&w, spec->peaks[i].amplitude_g, 4);
+        json_array_end(&w);
+    }
+    json_array_end(&w);
+    json_object_end(&w);
+    publish_json(SPECTRUM_TOPIC, &w);
+}
+
+static void publish_vibration_stats(const sensor_vibration_stats_t *vib)
+{
+    static const char *const axis_names[3] = {"x", "y", "z"};
+    char json[JSON_PAYLOAD_MAX];
+    json_writer_t w;
+    json_writer_init(&w, json, sizeof(json));
+    json_object_begin(&w);
+    json_kv_uint(&w, "t", vib->timestamp_us);
+    json_kv_uint(&w, "ms", vib->window_ms);
+    // Per axis: [rms, peak, crest, skewness, kurtosis]
+    for (int a = 0; a < 3; a++)
+    {
+        const sensor_axis_stats_t *s = &vib->axis[a];
+        json_key(&w, axis_names[a]);
+        json_array_begin(&w);
+        json_float(&w, s->rms_g, 4);
+        json_float(&w, s->peak_g, 4);
+        json_float(&w, s->crest_factor, 2);
+        json_float(&w, s->skewness, 2);
+        json_float(&w, s->kurtosis, 2);
+        json_array_end(&w);
+    }
+    json_object_end(&w);
+    publish_json(VIBRATION_TOPIC, &w);
+}
+
+static void publish_power(const ina226_data_t *p)
+{
+    char json[128];
+    json_writer_t w;
+    json_writer_init(&w, json, sizeof(json));
+    json_object_begin(&w);
+    json_kv_float(&w, "V", p->bus_voltage_v, 3);
+    json_kv_float(&w, "I", p->current_a, 4);
+    json_kv_float(&w, "P", p->power_w, 3);
+    json_key(&w, "Wh");
+    json_double(&w, p->energy_wh, 4);
+    json_object_end(&w);
+    publish_json(POWER_TOPIC, &w);
+}
+
+static void publish_health(const sensor_health_t *h)
+{
+    char json[192];
+    json_writer_t w;
+    json_writer_init(&w, json, sizeof(json));
+    json_object_begin(&w);
+    json_kv_uint(&w, "ovf", h->fifo_overflows);
+    json_kv_uint(&w, "lost", h->fifo_lost_frames);
+    json_kv_uint(&w, "rs_us", h->resync_last_us);
+    json_kv_uint(&w, "rs_max_us", h->resync_max_us);
+    json_kv_uint(&w, "ovf_t", h->last_overflow_us);
+    json_kv_uint(&w, "i2c_err", h->i2c_errors);
+    json_kv_uint(&w, "ina_to", h->ina_timeouts);
+    json_object_end(&w);
+    publish_json(HEALTH_TOPIC, &w);
+}
+
+// ------------------------- Streams -------------------------
+// Every stream is switched, paced and encoded on its own. Periodic streams
+// fall due at fixed times; the others publish whenever their source has
+// something new. The set can be changed at runtime on CONFIG_TOPIC.
+
+typedef enum
+{
+    STREAM_PREVIEW,   // decimated samples, paced by the sensor manager's stream rate
+    STREAM_SPECTRUM,  // every new spectrum
+    STREAM_VIBRATION, // every completed tumbling window
+    STREAM_POWER,     // power and energy summary
+    STREAM_HEALTH,    // acquisition health counters
+    STREAM_TRAINING,  // binary batches, on demand
+    STREAM_COUNT
+} stream_id_t;
+
+typedef enum
+{
+    ENCODER_JSON = 0,
+    ENCODER_BATCH_PLAIN,
+    ENCODER_BATCH_COMPRESSED,
+    ENCODER_COUNT
+} stream_encoder_t;
+
+static const char *const encoder_names[ENCODER_COUNT] = {"json", "plain", "compressed"};
+
+#if CONFIG_PUBLISHER_TRAINING_COMPRESSED
+#define TRAINING_ENCODER ENCODER_BATCH_COMPRESSED
+#else
+#define TRAINING_ENCODER ENCODER_BATCH_PLAIN
+#endif
+
+typedef struct
+{
+    const char *name; // key in config and state messages
+    bool enabled;
+    uint32_t period_ms; // periodic streams only, 0 = event driven
+    stream_encoder_t encoder;
+    TickType_t next_due;
+} publish_stream_t;
+
+static publish_stream_t streams[STREAM_COUNT] = {
+    [STREAM_PREVIEW] = {"preview", true, 0, ENCODER_JSON},
+    [STREAM_SPECTRUM] = {"spectrum", true, 0, ENCODER_JSON},
+    [STREAM_VIBRATION] = {"vibration", true, 0, ENCODER_JSON},
+    [STREAM_POWER] = {"power", true, 1000, ENCODER_JSON},
+    [STREAM_HEALTH] = {"health", true, 10000, ENCODER_JSON},
+    [STREAM_TRAINING] = {"training", false, 0, TRAINING_ENCODER},
+};
+
+#define MIN_PERIOD_MS 100  // fastest periodic stream
+#define EVENT_POLL_MS 100  // event-driven streams are checked at least this often
+
+static int preview_rate_hz = CONFIG_SENSOR_STREAM_RATE_HZ;
+static int32_t training_batches_left = -1; // -1 = until disabled
+static uint64_t last_vib_timestamp;
+
+// One stream change, parsed in the MQTT task and applied by the publisher task
+typedef struct
+{
+    stream_id_t stream;
+    int8_t enable;   // 1 / 0, -1 = unchanged
+    int8_t encoder;  // stream_encoder_t, -1 = unchanged
+    float rate_hz;   // 0 = unchanged
+    int32_t batches; // training: number of batches, -1 = until disabled
+} publish_cmd_t;
+
+#define CMD_QUEUE_LEN 8
+static QueueHandle_t cmd_queue;
+
+static void publish_state(void)
+{
+    char json[JSON_PAYLOAD_MAX];
+    json_writer_t w;
+    json_writer_init(&w, json, sizeof(json));
+    json_object_begin(&w);
+    for (int i = 0; i < STREAM_COUNT; i++)
+    {
+        const publish_stream_t *st = &streams[i];
+        json_key(&w, st->name);
+        json_object_begin(&w);
+        json_key(&w, "on");
+        json_bool(&w, st->enabled);
+        if (i == STREAM_PREVIEW)
+            json_kv_int(&w, "hz", preview_rate_hz);
+        else if (st->period_ms)
+            json_kv_float(&w, "hz", 1000.0f / st->period_ms, 2);
+        if (i == STREAM_TRAINING)
+        {
+            json_key(&w, "enc");
+            json_string(&w, encoder_names[st->encoder]);
+            json_kv_int(&w, "n", training_batches_left);
+        }
+        json_object_end(&w);
+    }
+    json_object_end(&w);
+    publish_json(STATE_TOPIC, &w);
+}
+
+static bool training_enable(bool enable)
+{
+    if (enable && !batch_tx)
+    {
+        batch_tx_size = batch_codec_max_size(BATCH_SIZE);
+        batch_tx = heap_caps_malloc(batch_tx_size, MALLOC_CAP_SPIRAM);
+        if (!batch_tx)
+            batch_tx = heap_caps_malloc(batch_tx_size, MALLOC_CAP_DEFAULT);
+        if (!batch_tx)
+        {
+            ESP_LOGE(TAG, "No memory for the batch encode buffer");
+            return false;
+        }
+    }
+    sensor_manager_set_batch_capture(enable);
+    streams[STREAM_TRAINING].enabled = enable;
+    return true;
+}
+
+static void apply_cmd(const publish_cmd_t *cmd)
+{
+    publish_stream_t *st = &streams[cmd->stream];
+
+    if (cmd->rate_hz > 0.0f)
+    {
+        if (cmd->stream == STREAM_PREVIEW)
+        {
+            int hz = (int)lrintf(cmd->rate_hz);
+            if (sensor_manager_set_stream_rate(hz) == ESP_OK)
+                preview_rate_hz = hz;
+            else
+                ESP_LOGW(TAG, "Unsupported preview rate %d Hz", hz);
+        }
+        else if (st->period_ms)
+        {
+            float ms = 1000.0f / cmd->rate_hz;
+            st->period_ms = ms < MIN_PERIOD_MS ? MIN_PERIOD_MS : (uint32_t)lrintf(ms);
+            st->next_due = xTaskGetTickCount();
+        }
+        else
+            ESP_LOGW(TAG, "Stream %s has no rate", st->name);
+    }
+
+    if (cmd->encoder >= 0)
+    {
+        // Batch encoders only make sense for batches, JSON for the rest
+        if ((cmd->encoder != ENCODER_JSON) == (cmd->stream == STREAM_TRAINING))
+            st->encoder = (stream_encoder_t)cmd->encoder;
+        else
+            ESP_LOGW(TAG, "Stream %s cannot use encoder %s", st->name, encoder_names[cmd->encoder]);
+    }
+
+    if (cmd->enable >= 0)
+    {
+        if (cmd->stream == STREAM_TRAINING)
+        {
+            training_batches_left = cmd->batches;
+            training_enable(cmd->enable);
+        }
+        else
+        {
+            if (cmd->stream == STREAM_PREVIEW && cmd->enable && !st->enabled)
+            {
+                // Samples queued while the preview was off are stale
+                synchronized_sample_t stale;
+                while (sensor_manager_get_next_sample(&stale, 0))
+                {
+                }
+            }
+            if (cmd->enable && !st->enabled)
+                st->next_due = xTaskGetTickCount();
+            st->enabled = cmd->enable;
+        }
+    }
+}
 
-    cJSON_AddNumberToObject(root, "percentage", slider_percentage);
-    cJSON_AddNumberToObject(root, "temperature_c", new_setpoint);
+static int encoder_from_name(const char *name)
+{
+    for (int i = 0; i < ENCODER_COUNT; i++)
+    {
+        if (strcmp(name, encoder_names[i]) == 0)
+            return i;
+    }
+    ESP_LOGW(TAG, "Unknown encoder %s", name);
+    return -1;
+}
 
-    char *json_string = cJSON_PrintUnformatted(root);
-    if (json_string)
+// Runs in the MQTT task. Every member names a stream, e.g.
+// {"preview":{"hz":20},"health":{"on":false},"training":{"n":3,"enc":"compressed"}}
+// on: enable / disable, hz: rate, enc: encoder, n: send n batches then stop
+// (implies on). Members left out are unchanged.
+static void on_config_message(const char *data, size_t len)
+{
+    cJSON *root = cJSON_ParseWithLength(data, len);
+    if (!cJSON_IsObject(root))
     {
-        // Push to TX queue (non-blocking)
-        network_manager_publish(SETPOINT_MQTT_TOPIC, json_string);
-        free(json_string);
+        ESP_LOGW(TAG, "Invalid publisher config");
+        cJSON_Delete(root);
+        return;
+    }
+
+    for (int i = 0; i < STREAM_COUNT; i++)
+    {
+        const cJSON *item = cJSON_GetObjectItemCaseSensitive(root, streams[i].name);
+        if (!cJSON_IsObject(item))
+            continue;
+
+        publish_cmd_t cmd = {.stream = (stream_id_t)i, .enable = -1, .encoder = -1, .batches = -1};
+        const cJSON *on = cJSON_GetObjectItemCaseSensitive(item, "on");
+        const cJSON *hz = cJSON_GetObjectItemCaseSensitive(item, "hz");
+        const cJSON *enc = cJSON_GetObjectItemCaseSensitive(item, "enc");
+        const cJSON *n = cJSON_GetObjectItemCaseSensitive(item, "n");
+        if (cJSON_IsBool(on))
+            cmd.enable = cJSON_IsTrue(on);
+        if (cJSON_IsNumber(hz) && hz->valuedouble > 0)
+            cmd.rate_hz = (float)hz->valuedouble;
+        if (cJSON_IsString(enc))
+            cmd.encoder = (int8_t)encoder_from_name(enc->valuestring);
+        if (cJSON_IsNumber(n) && n->valueint > 0)
+        {
+            cmd.batches = n->valueint;
+            if (cmd.enable < 0)
+                cmd.enable = 1;
+        }
+
+        if (xQueueSend(cmd_queue, &cmd, 0) != pdTRUE)
+            ESP_LOGW(TAG, "Config queue full, %s change dropped", streams[i].name);
     }
     cJSON_Delete(root);
 }
 
 // ------------------------- Publisher Task -------------------------
 
+static void publish_periodic(stream_id_t id)
+{
+    if (id == STREAM_POWER)
+    {
+        ina226_data_t power;
+        if (sensor_manager_get_latest_power(&power))
+            publish_power(&power);
+    }
+    else if (id == STREAM_HEALTH)
+    {
+        sensor_health_t health;
+        if (sensor_manager_get_health(&health))
+            publish_health(&health);
+    }
+}
+
+// Publish the periodic streams that are due. Each keeps its own schedule;
+// one that fell behind skips ahead instead of catching up in a burst.
+// Returns the time until the next one is due, at most EVENT_POLL_MS.
+static TickType_t run_periodic(void)
+{
+    TickType_t now = xTaskGetTickCount();
+    TickType_t wait = pdMS_TO_TICKS(EVENT_POLL_MS);
+    for (int i = 0; i < STREAM_COUNT; i++)
+    {
+        publish_stream_t *st = &streams[i];
+        if (!st->enabled || !st->period_ms)
+            continue;
+
+        TickType_t period = pdMS_TO_TICKS(st->period_ms);
+        if ((int32_t)(now - st->next_due) >= 0)
+        {
+            publish_periodic((stream_id_t)i);
+            st->next_due += period;
+            if ((int32_t)(now - st->next_due) >= 0)
+                st->next_due = now + period;
+        }
+        if (st->next_due - now < wait)
+            wait = st->next_due - now;
+    }
+    return wait;
+}
+
+static void run_events(void)
+{
+    sensor_spectrum_t spec;
+    if (streams[STREAM_SPECTRUM].enabled && sensor_manager_get_spectrum(&spec, 0))
+        publish_spectrum(&spec);
+
+    sensor_vibration_stats_t vib;
+    if (streams[STREAM_VIBRATION].enabled &&
+        sensor_manager_get_vibration_stats(SENSOR_VIB_WINDOW_TUMBLING, &vib) &&
+        vib.timestamp_us != last_vib_timestamp)
+    {
+        last_vib_timestamp = vib.timestamp_us;
+        publish_vibration_stats(&vib);
+    }
+}
+
+// Borrow one batch and send it as a single binary message
+static void publish_training(TickType_t wait)
+{
+    const synchronized_sample_t *buf = NULL;
+    int count = 0;
+    if (!sensor_manager_get_batch(&buf, &count, wait))
+        return;
+
+    batch_encoding_t encoding = streams[STREAM_TRAINING].encoder == ENCODER_BATCH_COMPRESSED
+                                    ? BATCH_ENCODING_COMPRESSED
+                                    : BATCH_ENCODING_PLAIN;
+    int64_t start = esp_timer_get_time();
+    size_t len = batch_codec_encode(buf, count, encoding, batch_tx, batch_tx_size);
+    sensor_manager_release_batch(buf);
+    ESP_LOGD(TAG, "Batch of %d samples: %u bytes, encoded in %lld us",
+             count, (unsigned)len, esp_timer_get_time() - start);
+
+    if (len)
+        network_manager_publish_binary(TRAINING_TOPIC, batch_tx, len);
+    else
+        ESP_LOGW(TAG, "Batch does not fit the encode buffer");
+
+    if (training_batches_left > 0 && --training_batches_left == 0)
+    {
+        training_enable(false);
+        publish_state();
+    }
+}
+
 static void publisher_task(void *arg)
 {
-    TickType_t last_wake = xTaskGetTickCount();
-    const TickType_t stream_interval = pdMS_TO_TICKS(100); // ~10 Hz
+    publish_state();
 
     for (;;)
     {
-        if (publish_mode == PUBLISH_MODE_STREAM)
+        publish_cmd_t cmd;
+        bool changed = false;
+        while (xQueueReceive(cmd_queue, &cmd, 0) == pdTRUE)
         {
-            // Stream mode: downsampled real-time samples
-            synchronized_sample_t pkt;
-            if (sensor_manager_get_next_sample(&pkt, portMAX_DELAY))
-            {
-                vTaskDelayUntil(&last_wake, stream_interval); // precise 10 Hz pacing
-
-                char json[128];
-                snprintf(json, sizeof(json),
-                         "{\"t\":%lld,\"ax\":%.3f,\"ay\":%.3f,\"az\":%.3f,"
-                         "\"I\":%.3f,\"T\":%.2f}",
-                         pkt.timestamp_us,
-                         pkt.accel_x_g, pkt.accel_y_g, pkt.accel_z_g,
-                         pkt.latest_current_a,
-                         pkt.latest_temperature_c);
-
-                // Non-blocking publish (queued)
-                network_manager_publish(STREAM_TOPIC, json);
-            }
+            apply_cmd(&cmd);
+            changed = true;
         }
-        else if (publish_mode == PUBLISH_MODE_BATCH)
+        if (changed)
+            publish_state();
+
+        TickType_t wait = run_periodic();
+        run_events();
+
+        // Sleep on whichever source is active, never past the next due
+        // stream, so no stream's pacing delays another
+        if (streams[STREAM_PREVIEW].enabled)
         {
-            // Batch mode: fetch 1000 samples and send them as JSON array
-            synchronized_sample_t buf[BATCH_SIZE];
-            int count = 0;
-            if (sensor_manager_get_batch(buf, &count, portMAX_DELAY))
+            synchronized_sample_t pkt;
+            if (sensor_manager_get_next_sample(&pkt, wait))
             {
-                cJSON *root = cJSON_CreateArray();
-                for (int i = 0; i < count; i++)
+                do
                 {
-                    cJSON *s = cJSON_CreateObject();
-                    cJSON_AddNumberToObject(s, "t", buf[i].timestamp_us);
-                    cJSON_AddNumberToObject(s, "ax", buf[i].accel_x_g);
-                    cJSON_AddNumberToObject(s, "ay", buf[i].accel_y_g);
-                    cJSON_AddNumberToObject(s, "az", buf[i].accel_z_g);
-                    cJSON_AddNumberToObject(s, "I", buf[i].latest_current_a);
-                    cJSON_AddNumberToObject(s, "T", buf[i].latest_temperature_c);
-                    cJSON_AddItemToArray(root, s);
-                }
-
-                char *json_string = cJSON_PrintUnformatted(root);
-                if (json_string)
-                {
-                    // Non-blocking publish (queued)
-                    network_manager_publish(TRAINING_TOPIC, json_string);
-                    free(json_string);
-                }
-                cJSON_Delete(root);
+                    publish_sample(&pkt);
+                } while (sensor_manager_get_next_sample(&pkt, 0));
             }
+            if (streams[STREAM_TRAINING].enabled)
+                publish_training(0);
         }
+        else if (streams[STREAM_TRAINING].enabled)
+            publish_training(wait);
+        else
+            xQueuePeek(cmd_queue, &cmd, wait); // a config change ends the wait
     }
 }
 
+// Called on every (re)connection; the task and the subscription, which the
+// network manager renews itself, are only set up the first time
 void data_publisher_start(void)
 {
+    static bool started;
+    if (started)
+        return;
+
+    cmd_queue = xQueueCreate(CMD_QUEUE_LEN, sizeof(publish_cmd_t));
+    if (!cmd_queue)
+    {
+        ESP_LOGE(TAG, "Failed to create the config queue");
+        return;
+    }
+    network_manager_subscribe(CONFIG_TOPIC, on_config_message);
     xTaskCreatePinnedToCore(publisher_task, "publisher",
                             8192, NULL, 5, NULL, 1);
+    started = true;
 }
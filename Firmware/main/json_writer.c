@@ -0,0 +1,185 @@
+#include "json_writer.h"
+#include <math.h>
+
+#define JSON_MAX_DECIMALS 6
+#define JSON_MAX_SCALED 9.2e18 // llrint() range
+
+static const uint32_t pow10_table[JSON_MAX_DECIMALS + 1] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+static inline void put(json_writer_t *w, char c)
+{
+    if (w->len + 1 < w->size)
+        w->buf[w->len++] = c;
+    else
+        w->overflow = true;
+}
+
+static void put_str(json_writer_t *w, const char *s)
+{
+    while (*s)
+        put(w, *s++);
+}
+
+// Separator before a value at the current level
+static void begin_value(json_writer_t *w)
+{
+    if (w->need_comma)
+        put(w, ',');
+    w->need_comma = true;
+}
+
+static void put_u64(json_writer_t *w, uint64_t v)
+{
+    char tmp[20];
+    int n = 0;
+    if (v <= UINT32_MAX)
+    {
+        // 32-bit division is a single instruction, 64-bit a library call
+        uint32_t v32 = (uint32_t)v;
+        do
+        {
+            tmp[n++] = (char)('0' + v32 % 10);
+            v32 /= 10;
+        } while (v32);
+    }
+    else
+    {
+        do
+        {
+            tmp[n++] = (char)('0' + v % 10);
+            v /= 10;
+        } while (v);
+    }
+    while (n)
+        put(w, tmp[--n]);
+}
+
+// scaled = value * 10^decimals, already rounded
+static void put_fixed(json_writer_t *w, int64_t scaled, int decimals)
+{
+    uint64_t u = scaled < 0 ? (uint64_t)(-scaled) : (uint64_t)scaled;
+    if (scaled < 0)
+        put(w, '-');
+    uint32_t p = pow10_table[decimals];
+    put_u64(w, u / p);
+    if (decimals)
+    {
+        put(w, '.');
+        uint32_t frac = (uint32_t)(u % p);
+        for (uint32_t d = p / 10; d; d /= 10)
+            put(w, (char)('0' + frac / d % 10));
+    }
+}
+
+static int clamp_decimals(int decimals)
+{
+    if (decimals < 0)
+        return 0;
+    return decimals > JSON_MAX_DECIMALS ? JSON_MAX_DECIMALS : decimals;
+}
+
+void json_writer_init(json_writer_t *w, char *buf, size_t size)
+{
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->overflow = size == 0;
+    w->need_comma = false;
+}
+
+const char *json_writer_finish(json_writer_t *w)
+{
+    if (w->overflow)
+        return NULL;
+    w->buf[w->len] = '\0';
+    return w->buf;
+}
+
+void json_object_begin(json_writer_t *w)
+{
+    begin_value(w);
+    put(w, '{');
+    w->need_comma = false;
+}
+
+void json_object_end(json_writer_t *w)
+{
+    put(w, '}');
+    w->need_comma = true;
+}
+
+void json_array_begin(json_writer_t *w)
+{
+    begin_value(w);
+    put(w, '[');
+    w->need_comma = false;
+}
+
+void json_array_end(json_writer_t *w)
+{
+    put(w, ']');
+    w->need_comma = true;
+}
+
+void json_key(json_writer_t *w, const char *key)
+{
+    begin_value(w);
+    put(w, '"');
+    put_str(w, key);
+    put_str(w, "\":");
+    w->need_comma = false;
+}
+
+void json_int(json_writer_t *w, int64_t v)
+{
+    begin_value(w);
+    if (v < 0)
+    {
+        put(w, '-');
+        put_u64(w, (uint64_t)0 - (uint64_t)v);
+    }
+    else
+        put_u64(w, (uint64_t)v);
+}
+
+void json_uint(json_writer_t *w, uint64_t v)
+{
+    begin_value(w);
+    put_u64(w, v);
+}
+
+void json_float(json_writer_t *w, float v, int decimals)
+{
+    begin_value(w);
+    decimals = clamp_decimals(decimals);
+    float x = v * (float)pow10_table[decimals];
+    if (!isfinite(x) || fabsf(x) >= (float)JSON_MAX_SCALED)
+        put_str(w, "null");
+    else
+        put_fixed(w, llrintf(x), decimals);
+}
+
+void json_double(json_writer_t *w, double v, int decimals)
+{
+    begin_value(w);
+    decimals = clamp_decimals(decimals);
+    double x = v * pow10_table[decimals];
+    if (!isfinite(x) || fabs(x) >= JSON_MAX_SCALED)
+        put_str(w, "null");
+    else
+        put_fixed(w, llrint(x), decimals);
+}
+
+void json_bool(json_writer_t *w, bool v)
+{
+    begin_value(w);
+    put_str(w, v ? "true" : "false");
+}
+
+void json_string(json_writer_t *w, const char *s)
+{
+    begin_value(w);
+    put(w, '"');
+    put_str(w, s);
+    put(w, '"');
+}
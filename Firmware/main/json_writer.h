@@ -0,0 +1,67 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming JSON writer into a caller-supplied buffer. No heap, no printf:
+// integers are converted digit by digit and reals as fixed-point with a given
+// number of decimals. Commas are inserted automatically. Non-finite reals are
+// written as null. Writing past the end only sets the overflow flag, so a
+// message can be built without checking every call.
+
+typedef struct
+{
+    char *buf;
+    size_t size;
+    size_t len;
+    bool overflow;
+    bool need_comma; // a value was written at this nesting level
+} json_writer_t;
+
+void json_writer_init(json_writer_t *w, char *buf, size_t size);
+
+/**
+ * @brief Terminate the string.
+ * @return The buffer, or NULL if the message did not fit
+ */
+const char *json_writer_finish(json_writer_t *w);
+
+void json_object_begin(json_writer_t *w);
+void json_object_end(json_writer_t *w);
+void json_array_begin(json_writer_t *w);
+void json_array_end(json_writer_t *w);
+
+/**
+ * @brief Start a member; the next value or begin call is its value.
+ * @param key Written as is, must not need escaping
+ */
+void json_key(json_writer_t *w, const char *key);
+
+void json_int(json_writer_t *w, int64_t v);
+void json_uint(json_writer_t *w, uint64_t v);
+void json_float(json_writer_t *w, float v, int decimals);   // decimals 0..6
+void json_double(json_writer_t *w, double v, int decimals); // for values beyond float precision
+void json_bool(json_writer_t *w, bool v);
+void json_string(json_writer_t *w, const char *s); // written as is, like json_key()
+
+static inline void json_kv_int(json_writer_t *w, const char *key, int64_t v)
+{
+    json_key(w, key);
+    json_int(w, v);
+}
+
+static inline void json_kv_uint(json_writer_t *w, const char *key, uint64_t v)
+{
+    json_key(w, key);
+    json_uint(w, v);
+}
+
+static inline void json_kv_float(json_writer_t *w, const char *key, float v, int decimals)
+{
+    json_key(w, key);
+    json_float(w, v, decimals);
+}
+
+#endif // JSON_WRITER_H
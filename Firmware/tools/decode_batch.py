@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""Decode binary training batches (device/training/samples).
+
+Format: see main/batch_codec.h. Capture a batch with e.g.
+
+    mosquitto_sub -h <broker> -t device/training/samples -C 1 > batch.bin
+
+and convert it to CSV with
+
+    python3 decode_batch.py batch.bin > batch.csv
+
+decode() can also be imported and fed MQTT payloads directly.
+"""
+
+import struct
+import sys
+
+HEADER = struct.Struct("<2sBBHHIQI")
+MAGIC = b"SB"
+VERSIONS = (1, 2)
+FLAG_SEQ = 0x01
+FLAG_COMPRESSED = 0x02
+FLAG_SEQ32 = 0x04
+NAN_RAW = -0x8000  # version 2: missing measurement
+
+# Channel bit -> column name, in column order
+CHANNELS = [
+    (0x0001, "ax"),
+    (0x0002, "ay"),
+    (0x0004, "az"),
+    (0x0008, "gx"),
+    (0x0010, "gy"),
+    (0x0020, "gz"),
+    (0x0040, "Td"),
+    (0x0080, "I"),
+    (0x0100, "T"),
+]
+
+
+class BitReader:
+    """MSB-first reader for the compressed stream."""
+
+    def __init__(self, data):
+        self.value = int.from_bytes(data, "big")
+        self.left = 8 * len(data)
+
+    def bits(self, n):
+        if n > self.left:
+            raise ValueError("truncated compressed batch")
+        self.left -= n
+        return (self.value >> self.left) & ((1 << n) - 1)
+
+    def number(self):
+        # '0', '10' + 3 bits, '110' + 8, '1110' + 13, '1111' + 32
+        if not self.bits(1):
+            return 0
+        for width in (3, 8, 13):
+            if not self.bits(1):
+                return self.bits(width)
+        return self.bits(32)
+
+
+def unzigzag(v):
+    return (v >> 1) ^ -(v & 1)
+
+
+def to_int16(v):
+    return v - 0x10000 if v & 0x8000 else v
+
+
+def decode_compressed(data, count, gaps, start_us, first_seq, ncols):
+    r = BitReader(data)
+    t = [start_us]
+    delta = 0
+    for _ in range(count - 1):
+        delta += unzigzag(r.number())
+        t.append(t[-1] + delta)
+
+    seq = [first_seq]
+    for _ in range(count - 1):
+        seq.append(seq[-1] + 1 + (r.number() if gaps else 0))
+
+    cols = []
+    for _ in range(ncols):
+        col = [to_int16(r.bits(16))]
+        for _ in range(count - 1):
+            col.append(to_int16((col[-1] + unzigzag(r.number())) & 0xFFFF))
+        cols.append(col)
+    return t, seq, cols
+
+
+def decode(payload):
+    """Return a dict of column name -> list of values, plus "seq" and "t" (µs)."""
+    magic, version, flags, mask, count, first_seq, start_us, period_ns = HEADER.unpack_from(payload, 0)
+    if magic != MAGIC:
+        raise ValueError("not a training batch")
+    if version not in VERSIONS:
+        raise ValueError("unsupported batch version %d" % version)
+    nan_raw = NAN_RAW if version >= 2 else None
+
+    def scaled(col, scale):
+        return [float("nan") if v == nan_raw else v * scale for v in col]
+
+    names = [name for bit, name in CHANNELS if mask & bit]
+    off = HEADER.size
+    scales = struct.unpack_from("<%df" % len(names), payload, off)
+    off += 4 * len(names)
+
+    out = {}
+    if flags & FLAG_COMPRESSED:
+        t, seq, cols = decode_compressed(payload[off:], count, flags & FLAG_SEQ, start_us, first_seq, len(names))
+        for name, scale, col in zip(names, scales, cols):
+            out[name] = scaled(col, scale)
+        out["seq"] = seq
+        out["t"] = t
+        return out
+
+    for name, scale in zip(names, scales):
+        raw = struct.unpack_from("<%dh" % count, payload, off)
+        off += 2 * count
+        out[name] = scaled(raw, scale)
+
+    if flags & FLAG_SEQ:
+        deltas = struct.unpack_from("<%d%s" % (count, "I" if flags & FLAG_SEQ32 else "H"), payload, off)
+    else:
+        deltas = range(count)
+    out["seq"] = [first_seq + d for d in deltas]
+    out["t"] = [start_us + d * period_ns / 1000.0 for d in deltas]
+    return out
+
+
+def main(argv):
+    if len(argv) < 2:
+        sys.stderr.write("usage: %s batch.bin [...]\n" % argv[0])
+        return 1
+
+    header_written = False
+    for path in argv[1:]:
+        with open(path, "rb") as f:
+            batch = decode(f.read())
+        cols = ["seq", "t"] + [name for _, name in CHANNELS if name in batch]
+        if not header_written:
+            print(",".join(cols))
+            header_written = True
+        for i in range(len(batch["seq"])):
+            print(",".join("%.6g" % batch[c][i] if c not in ("seq", "t") else "%d" % batch[c][i] for c in cols))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))